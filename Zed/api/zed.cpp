@@ -0,0 +1,205 @@
+#include "zed.h"
+#include "../vm/vm.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+
+static_assert(zed::reg::BP == bytecode::reg::BP && zed::reg::RP == bytecode::reg::RP &&
+			  zed::reg::PP == bytecode::reg::PP && zed::reg::FZ == bytecode::reg::FZ &&
+			  zed::reg::W(0) == bytecode::reg::W0 && zed::reg::B(0) == bytecode::reg::B0 && zed::reg::Count == bytecode::reg::Count,
+			  "Embedding API register IDs do not match the bytecode register IDs");
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Errors
+
+zed::Error::Error(const char* const what, const int loc) : std::runtime_error(what), loc(loc) {}
+
+int zed::Error::getLoc() const noexcept {
+	return loc;
+}
+
+// Turns executor exceptions into the API's own
+template<typename F>
+static auto translate(F&& f) {
+	try {
+		return f();
+	} catch (const executor::ExecutorException& e) {
+		throw zed::Error(e.what(), e.getLoc());
+	}
+}
+
+// Throws unless reg is one of the IDs in zed::reg, blaming the instruction at loc
+static void checkRegister(const int reg, const int loc) {
+	if (reg < 0 || reg >= zed::reg::Count) {
+		throw zed::Error(("There is no register " + std::to_string(reg)).c_str(), loc);
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Registers
+
+zed::Registers::Registers(int32_t* const words, int8_t* const bytes) noexcept : words(words), bytes(bytes) {}
+
+int32_t& zed::Registers::word(const int reg) const {
+	checkRegister(reg, 0);
+	return words[reg];
+}
+
+int8_t& zed::Registers::byte(const int reg) const {
+	checkRegister(reg, 0);
+	return bytes[reg];
+}
+
+float zed::Registers::getFloat(const int reg) const {
+	float val;
+	std::memcpy(&val, &word(reg), sizeof(val));
+	return val;
+}
+
+void zed::Registers::setFloat(const int reg, const float val) const {
+	std::memcpy(&word(reg), &val, sizeof(val));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Program
+
+struct zed::Program::Impl {
+	std::shared_ptr<const bytecode::Image> image;
+};
+
+zed::Program::Program(std::shared_ptr<const Impl> impl) noexcept : impl(std::move(impl)) {}
+
+zed::Program zed::Program::load(const char* const path) {
+	std::fstream file;
+	file.open(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error(std::string("Could not open file \"") + path + "\"");
+	}
+	return load(file);
+}
+
+zed::Program zed::Program::load(std::iostream& file) {
+	return Program(std::make_shared<const Impl>(Impl{ std::make_shared<const bytecode::Image>(file) }));
+}
+
+int zed::Program::size() const noexcept {
+	return impl->image->size();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// VM
+
+struct zed::VM::Impl {
+	executor::VM vm;
+
+	explicit Impl(const executor::ExecutorSettings& settings) : vm(settings) {}
+};
+
+static executor::ExecutorSettings toSettings(const zed::Options& options) {
+	executor::ExecutorSettings settings;
+	settings.stackSize = options.stackSize;
+	settings.taskStackSize = options.taskStackSize;
+	settings.heapSize = options.heapSize;
+	settings.workers = options.workers;
+	settings.ioWorkers = options.ioWorkers;
+	settings.maxInstructions = options.maxInstructions;
+	settings.timeoutMs = options.timeoutMs;
+	return settings;
+}
+
+zed::VM::VM() : VM(Options{}) {}
+zed::VM::VM(const Options& options) : impl(translate([&] { return std::make_unique<Impl>(toSettings(options)); })) {}
+zed::VM::~VM() = default;
+
+zed::VM::VM(VM&&) noexcept = default;
+zed::VM& zed::VM::operator=(VM&&) noexcept = default;
+
+void zed::VM::load(const Program& program) {
+	translate([&] { impl->vm.load(program.impl->image); });
+}
+
+void zed::VM::reset() {
+	translate([&] { impl->vm.reset(); });
+}
+
+void zed::VM::run() {
+	translate([&] { impl->vm.run(); });
+}
+
+bool zed::VM::step() {
+	return translate([&] { return impl->vm.step(); });
+}
+
+bool zed::VM::isHalted() const noexcept {
+	return impl->vm.isHalted();
+}
+
+void zed::VM::snapshot(std::ostream& out) {
+	translate([&] { impl->vm.snapshot(out); });
+}
+
+void zed::VM::restore(std::istream& in) {
+	translate([&] { impl->vm.restore(in); });
+}
+
+int zed::VM::clone() {
+	return translate([&] { return impl->vm.clone(); });
+}
+
+void zed::VM::setStreams(std::istream& in, std::ostream& out) noexcept {
+	impl->vm.setStreams(in, out);
+}
+
+void zed::VM::addNative(const char* const name, Native native) {
+	static_assert(sizeof(bytecode::types::WordVal) == sizeof(int32_t) && sizeof(bytecode::types::ByteVal) == sizeof(int8_t),
+				  "Registers can't be handed to native functions as they are");
+	impl->vm.addNative(name, [native = std::move(native)](bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg) {
+		native(Registers(reinterpret_cast<int32_t*>(wordReg), reinterpret_cast<int8_t*>(byteReg)));
+	});
+}
+
+int32_t zed::VM::getIP() const noexcept {
+	return impl->vm.getIP();
+}
+
+void zed::VM::setIP(const int32_t ip) noexcept {
+	impl->vm.setIP(ip);
+}
+
+int32_t zed::VM::getWord(const int reg) const {
+	checkRegister(reg, getIP());
+	return impl->vm.wordRegister(static_cast<bytecode::types::reg_t>(reg)).int_;
+}
+
+float zed::VM::getFloat(const int reg) const {
+	checkRegister(reg, getIP());
+	return impl->vm.wordRegister(static_cast<bytecode::types::reg_t>(reg)).float_;
+}
+
+int8_t zed::VM::getByte(const int reg) const {
+	checkRegister(reg, getIP());
+	return impl->vm.byteRegister(static_cast<bytecode::types::reg_t>(reg)).byte;
+}
+
+void zed::VM::setWord(const int reg, const int32_t val) {
+	checkRegister(reg, getIP());
+	impl->vm.wordRegister(static_cast<bytecode::types::reg_t>(reg)).int_ = val;
+}
+
+void zed::VM::setFloat(const int reg, const float val) {
+	checkRegister(reg, getIP());
+	impl->vm.wordRegister(static_cast<bytecode::types::reg_t>(reg)).float_ = val;
+}
+
+void zed::VM::setByte(const int reg, const int8_t val) {
+	checkRegister(reg, getIP());
+	impl->vm.byteRegister(static_cast<bytecode::types::reg_t>(reg)).byte = val;
+}
+
+void zed::VM::read(const int32_t addr, void* const out, const size_t size) const noexcept {
+	std::memcpy(out, executor::VM::memory(addr), size);
+}
+
+void zed::VM::write(const int32_t addr, const void* const in, const size_t size) noexcept {
+	std::memcpy(executor::VM::memory(addr), in, size);
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Embedding API
+
+// Everything needed to run Zed programs from other C++ code
+// Only depends on the standard library, and keeps the executor's internals behind pointers, so it doesn't change shape when they do
+namespace zed {
+	// Register IDs, matching the names used in assembly
+	namespace reg {
+		constexpr int BP = 0;
+		constexpr int RP = 1;
+		constexpr int PP = 2;
+		constexpr int FZ = 3;
+		constexpr int W(const int n) noexcept { return 4 + n; }
+		constexpr int B(const int n) noexcept { return 18 + n; }
+		// One more than the highest ID
+		constexpr int Count = 32;
+	}
+
+	// An error from a running program
+	class Error : public std::runtime_error {
+	private:
+		int loc;
+
+	public:
+		Error(const char* const what, const int loc);
+
+		// The offset in the program where it happened
+		[[nodiscard]] int getLoc() const noexcept;
+	};
+
+	// The registers of the guest thread that called a native function, by the IDs in reg. Throws zed::Error for any other ID
+	// Guest addresses are host addresses, so a native function can use pointers it finds in them as they are
+	class Registers {
+		friend class VM;
+
+	private:
+		int32_t* words;
+		int8_t* bytes;
+
+		Registers(int32_t* const words, int8_t* const bytes) noexcept;
+
+	public:
+		[[nodiscard]] int32_t& word(const int reg) const;
+		[[nodiscard]] int8_t& byte(const int reg) const;
+		[[nodiscard]] float getFloat(const int reg) const;
+		void setFloat(const int reg, const float val) const;
+		// The memory a word register points at
+		template<typename T>
+		[[nodiscard]] T* pointer(const int reg) const {
+			return reinterpret_cast<T*>(static_cast<intptr_t>(word(reg)));
+		}
+	};
+
+	// A host function that programs call with "native @name". It runs on whichever guest thread called it
+	typedef std::function<void(const Registers& regs)> Native;
+
+	// A loaded .eze file. Immutable and cheap to copy, so one can be shared by any number of VMs on any number of threads
+	class Program {
+		friend class VM;
+
+	private:
+		struct Impl;
+		std::shared_ptr<const Impl> impl;
+
+		explicit Program(std::shared_ptr<const Impl> impl) noexcept;
+
+	public:
+		// Throws std::runtime_error if the file can't be opened
+		[[nodiscard]] static Program load(const char* const path);
+		[[nodiscard]] static Program load(std::iostream& file);
+
+		[[nodiscard]] int size() const noexcept;
+	};
+
+	// How a VM runs
+	struct Options {
+		// Bytes of address space for the stack
+		int stackSize = 0x1000000;
+		// Bytes of stack for each task spawned with taskspawn, rounded up to whole pages. Fully allocated, with a guard page after it
+		int taskStackSize = 0x1000;
+		// Bytes of address space for the heap, which holds everything the program allocates
+		int heapSize = 0x4000000;
+		// Host threads for parfor loops, or 0 for one per core
+		int workers = 0;
+		// Host threads for aioread and aiowrite
+		int ioWorkers = 4;
+		// Instructions to run before throwing, or 0 for no limit
+		int64_t maxInstructions = 0;
+		// Milliseconds to run before throwing, or 0 for no limit
+		int64_t timeoutMs = 0;
+	};
+
+	// A reusable virtual machine. Load a program once, then run, step, reset and inspect it as often as needed
+	// A VM must only be used by one thread at a time, but separate VMs can run on separate threads
+	class VM {
+	private:
+		struct Impl;
+		std::unique_ptr<Impl> impl;
+
+	public:
+		VM();
+		explicit VM(const Options& options);
+		~VM();
+
+		VM(VM&&) noexcept;
+		VM& operator=(VM&&) noexcept;
+
+		// Loads a program and resets to its first instruction
+		void load(const Program& program);
+		// Puts the loaded program back the way it was right after loading
+		void reset();
+
+		// Runs until the program halts. Throws zed::Error
+		void run();
+		// Runs one instruction, returning false once the program has halted. Throws zed::Error
+		bool step();
+		[[nodiscard]] bool isHalted() const noexcept;
+
+		// Saves the running program to a stream, to carry on later with restore. Throws zed::Error if it has threads or tasks
+		void snapshot(std::ostream& out);
+		// Replaces the program with a snapshot. Throws zed::Error if its memory can't go back at the same addresses in this process
+		void restore(std::istream& in);
+		// Forks the process, returning 0 in the child, which has a copy-on-write copy of this VM, and the child's ID in the parent
+		// Throws zed::Error on Windows
+		int clone();
+
+		// Where the program's input comes from and its output goes. Defaults to std::cin and std::cout
+		void setStreams(std::istream& in, std::ostream& out) noexcept;
+		// Lets programs call a function with "native @name". Kept across loads and resets
+		// Throws std::invalid_argument in the unlikely case that two names hash the same
+		void addNative(const char* const name, Native native);
+
+		[[nodiscard]] int32_t getIP() const noexcept;
+		void setIP(const int32_t ip) noexcept;
+
+		// By the IDs in reg. Throw zed::Error for any other ID
+		[[nodiscard]] int32_t getWord(const int reg) const;
+		[[nodiscard]] float getFloat(const int reg) const;
+		[[nodiscard]] int8_t getByte(const int reg) const;
+		void setWord(const int reg, const int32_t val);
+		void setFloat(const int reg, const float val);
+		void setByte(const int reg, const int8_t val);
+
+		// Copies guest memory (at an address held in a register) out of or into the VM
+		void read(const int32_t addr, void* const out, const size_t size) const noexcept;
+		void write(const int32_t addr, const void* const in, const size_t size) noexcept;
+	};
+}
\ No newline at end of file
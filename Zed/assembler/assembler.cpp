@@ -3,6 +3,7 @@
 #include "../utils/io_utils.h"
 #include "../utils/string_lookup.h"
 #include <fstream>
+#include <map>
 #include <optional>
 #include <vector>
 #include <unordered_map>
@@ -581,6 +582,14 @@ int assembler::assemble_(std::iostream& inputFile, std::iostream& outputFile, co
 						outputFile.write(str, static_cast<std::streamsize>(strlen) + 1);
 						byteCounter += strlen + 1;
 						break;
+
+					case 7: // ARG_NATIVE
+						if (str[0] != '@' || strlen < 2) {
+							throw AssemblerException(AssemblerException::ErrorType::INVALID_NATIVE_PARSE, line, column);
+						}
+						word = static_cast<word_t>(bytecode::nativeId(std::string_view(str + 1, strlen - 1)));
+						ASM_WRITE(word, word_t);
+						break;
 				}
 
 				carg++;
@@ -622,6 +631,21 @@ int assembler::assemble_(std::iostream& inputFile, std::iostream& outputFile, co
 		}
 	}
 
+	if (settings.symbolsPath) {
+		std::map<word_t, const std::string*> symbols;
+		for (const auto& [labelname, label] : labels) {
+			if (labelname[0] == '@') symbols.emplace(label.val.value(), &labelname);
+		}
+
+		std::ofstream symbolsFile(settings.symbolsPath, std::ios::out | std::ios::trunc);
+		for (const auto& [offset, name] : symbols) {
+			symbolsFile << offset << " " << *name << "\n";
+		}
+		if (!symbolsFile) {
+			stream << IO_WARN "Could not write symbols to \"" << settings.symbolsPath << "\"" IO_NORM "\n";
+		}
+	}
+
 	ASM_DEBUG(IO_END);
 
 	return 0;
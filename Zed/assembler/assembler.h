@@ -15,6 +15,9 @@ namespace assembler {
 	// Holds settings info about the assembly process
 	struct AssemblerSettings {
 		Flags flags;
+		// Where to write the offset of every label, one "offset label" per line, or null to not bother
+		// For putting names to addresses, like the executor's sampling profiler does
+		const char* symbolsPath = nullptr;
 	};
 
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -35,6 +38,7 @@ namespace assembler {
 			UNDEFINED_LABEL,
 			UNDEFINED_VAR,
 			MISPLACED_GLOBAL,
+			INVALID_NATIVE_PARSE,
 			Count
 		};
 
@@ -50,7 +54,8 @@ namespace assembler {
 			"Invalid global variable during parsing",
 			"Undefined label",
 			"Undefined global variable",
-			"Cannot attempt to set global variable after normal program opcodes"
+			"Cannot attempt to set global variable after normal program opcodes",
+			"Invalid native function name during parsing"
 		};
 
 		ErrorType eType;
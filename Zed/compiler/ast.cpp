@@ -1,11 +1,23 @@
 #include "ast.h"
 #include "patterns.h"
 #include "treeform.h"
+#include "compiler.h"
+#include "tokenizer.h"
 
 int compiler::ast::makeAST(ast::Tree& tree, const tokens::TokenData& tokenData, CompilerStatus& status, const CompilerSettings& settings, std::ostream& stream) {
+	// Reserved for parallel for loops, which can't be parsed until there are loops at all
+	int out = 0;
+	for (const tokens::Token& token : tokenData.getTokens()) {
+		if (token.type == tokens::TokenType::PARALLEL) {
+			status.addIssue(CompilerIssue::Type::UNSUPPORTED_KEYWORD, token.loc, "parallel");
+			out = 1;
+		}
+	}
+	if (out) return out;
+
 	ast::MatchData matchData(tokenData);
 
-	int out = ast::matchPatterns(tokenData, matchData, status, settings, stream);
+	out = ast::matchPatterns(tokenData, matchData, status, settings, stream);
 
 	if (out) return out;
 
@@ -65,6 +65,7 @@ namespace compiler {
 			INVALID_TYPE_MACRO,
 			INVALID_TYPE_ARITH_BINOP,
 			INVALID_TYPE_ANNOTATED,
+			UNSUPPORTED_KEYWORD,
 
 			// Abortive
 			GEN_ABORT,
@@ -109,6 +110,7 @@ namespace compiler {
 			"Invalid type for macro argument",
 			"Invalid (illegal or non-matching) types for arithmetic binop",
 			"Expression type cannot be casted to annotation type",
+			"Keyword not supported yet",
 
 			"General abortive error",
 			"Maximum token length exceeded",
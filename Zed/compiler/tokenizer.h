@@ -81,6 +81,7 @@ namespace compiler::tokens {
 		RETURN,
 		WHILE,
 		FOR,
+		PARALLEL,
 		IF,
 		ELSE,
 		ELIF,
@@ -142,6 +143,7 @@ namespace compiler::tokens {
 		"return",
 		"while",
 		"for",
+		"parallel",
 		"if",
 		"else",
 		"elif",
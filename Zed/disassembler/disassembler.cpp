@@ -1,6 +1,10 @@
 #include "disassembler.h"
 #include "../utils/io_utils.h"
+#include "../vm/coverage.h"
 #include <fstream>
+#include <iomanip>
+#include <optional>
+#include <unordered_map>
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Disassembler Exceptions
@@ -50,58 +54,112 @@ int disassembler::disassemble(const char* const inputPath, const char* const out
 	return 1;
 }
 
-int disassembler::disassemble_(std::iostream& inputFile, std::iostream& outputFile, const DisassemblerSettings& settings, std::ostream& stream) {
+// Writes the instruction at the program's position, and moves past it
+static void writeInstruction(bytecode::Program& program, std::iostream& outputFile) {
+	using namespace disassembler;
 	using namespace bytecode::types;
-	using namespace bytecode::Opcode;
 	using namespace bytecode;
 
-	Program program(inputFile);
-	program.goto_(bytecode::FIRST_INSTR_ADDR_LOCATION);
-	program.goto_(*reinterpret_cast<types::word_t*>(program.pos()));
-
 	opcode_t opcode = 0;
 	reg_t rid1 = 0;
 	word_t word = 0;
 	byte_t byte = 0;
 
-	while (program.inBounds()) {
-		program.read<opcode_t>(&opcode);
-		if (opcode >= Opcode::ValidCount) {
-			throw DisassemblerException(DisassemblerException::ErrorType::INVALID_OPCODE);
+	program.read<opcode_t>(&opcode);
+	if (opcode >= Opcode::ValidCount) {
+		throw DisassemblerException(DisassemblerException::ErrorType::INVALID_OPCODE);
+	}
+	outputFile << std::left << std::setw(10) << opcodeStrings[opcode] << std::right << "  ";
+	for (const int& arg : opcodeArgs[opcode]) {
+		switch (static_cast<OpcodeArgType>(arg)) {
+			case OpcodeArgType::ARG_WORD_REG:
+				program.read<reg_t>(&rid1);
+				if (rid1 == reg::BP || rid1 == reg::RP || rid1 == reg::PP) {
+					outputFile << std::left << std::setw(10) << regStrings[rid1] << std::right << "  ";
+				} else if (rid1 >= reg::W0 && rid1 < reg::B0) {
+					outputFile << "W" << std::left << std::setw(9) << (rid1 - reg::W0) << std::right << "  ";
+				} else {
+					throw DisassemblerException(DisassemblerException::ErrorType::INVALID_WORD_REG);
+				}
+				break;
+			case OpcodeArgType::ARG_BYTE_REG:
+				program.read<reg_t>(&rid1);
+				if (rid1 == reg::FZ) {
+					outputFile << std::left << std::setw(10) << regStrings[rid1] << std::right << "  ";
+				} else if (rid1 >= reg::B0 && rid1 < reg::Count) {
+					outputFile << "B" << std::left << std::setw(9) << (rid1 - reg::B0) << std::right << "  ";
+				} else {
+					throw DisassemblerException(DisassemblerException::ErrorType::INVALID_BYTE_REG);
+				}
+				break;
+			case OpcodeArgType::ARG_WORD:
+				program.read<word_t>(&word);
+				outputFile << "0x" << std::setfill('0') << std::setw(8) << IO_HEX << word << IO_DEC << std::setfill(' ') << "  ";
+				break;
+			case OpcodeArgType::ARG_NATIVE:
+				// Only the hash of the name is kept
+				program.read<word_t>(&word);
+				outputFile << "@#" << std::setfill('0') << std::setw(8) << IO_HEX << word << IO_DEC << std::setfill(' ') << "  ";
+				break;
+			case OpcodeArgType::ARG_BYTE:
+				program.read<byte_t>(&byte);
+				outputFile << "0x" << std::setfill('0') << std::setw(2) << IO_HEX << byte << IO_DEC << std::setfill(' ') << "      " "  ";
+				break;
 		}
-		outputFile << std::left << std::setw(10) << opcodeStrings[opcode] << std::right << "  ";
-		for (const int& arg : opcodeArgs[opcode]) {
-			switch (static_cast<OpcodeArgType>(arg)) {
-				case OpcodeArgType::ARG_WORD_REG:
-					program.read<reg_t>(&rid1);
-					if (rid1 == reg::BP || rid1 == reg::RP || rid1 == reg::PP) {
-						outputFile << std::left << std::setw(10) << regStrings[rid1] << std::right << "  ";
-					} else if (rid1 >= reg::W0 && rid1 < reg::B0) {
-						outputFile << "W" << std::left << std::setw(9) << (rid1 - reg::W0) << std::right << "  ";
-					} else {
-						throw DisassemblerException(DisassemblerException::ErrorType::INVALID_WORD_REG);
-					}
-					break;
-				case OpcodeArgType::ARG_BYTE_REG:
-					program.read<reg_t>(&rid1);
-					if (rid1 == reg::FZ) {
-						outputFile << std::left << std::setw(10) << regStrings[rid1] << std::right << "  ";
-					} else if (rid1 >= reg::B0 && rid1 < reg::Count) {
-						outputFile << "B" << std::left << std::setw(9) << (rid1 - reg::B0) << std::right << "  ";
-					} else {
-						throw DisassemblerException(DisassemblerException::ErrorType::INVALID_BYTE_REG);
-					}
-					break;
-				case OpcodeArgType::ARG_WORD:
-					program.read<word_t>(&word);
-					outputFile << "0x" << std::setfill('0') << std::setw(8) << IO_HEX << word << IO_DEC << std::setfill(' ') << "  ";
-					break;
-				case OpcodeArgType::ARG_BYTE:
-					program.read<byte_t>(&byte);
-					outputFile << "0x" << std::setfill('0') << std::setw(2) << IO_HEX << byte << IO_DEC << std::setfill(' ') << "      " "  ";
-					break;
+	}
+}
+
+int disassembler::disassemble_(std::iostream& inputFile, std::iostream& outputFile, const DisassemblerSettings& settings, std::ostream& stream) {
+	using namespace bytecode::types;
+	using namespace bytecode::Opcode;
+	using namespace bytecode;
+
+	Program program(inputFile);
+
+	if (settings.coveragePath) {
+		std::ifstream coverageFile(settings.coveragePath);
+		if (!coverageFile.is_open()) {
+			throw DisassemblerException(DisassemblerException::ErrorType::BAD_COVERAGE, std::string("could not open \"") + settings.coveragePath + "\"");
+		}
+		std::optional<executor::Coverage> coverage;
+		try {
+			coverage.emplace(coverageFile);
+		} catch (const std::runtime_error& e) {
+			throw DisassemblerException(DisassemblerException::ErrorType::BAD_COVERAGE, e.what());
+		}
+		if (coverage->programSize != program.size()) {
+			throw DisassemblerException(DisassemblerException::ErrorType::BAD_COVERAGE, "it's of a different program");
+		}
+
+		std::unordered_map<word_t, const executor::Branch*> branches;
+		for (const executor::Branch& branch : coverage->branches) branches[branch.offset] = &branch;
+
+		// Like gcov: how often each instruction's block ran, or ##### if it never did
+		for (const executor::Block& block : coverage->blocks) {
+			outputFile << "\n" << std::setw(10) << "" << "  | ; BYTE" << block.offset << "\n";
+			program.goto_(block.offset);
+			while (program.offset() < block.offset + block.size) {
+				const word_t offset = program.offset();
+				if (block.count) {
+					outputFile << std::setw(10) << block.count << "  | ";
+				} else {
+					outputFile << std::setw(10) << "#####" << "  | ";
+				}
+				writeInstruction(program, outputFile);
+				if (const auto it = branches.find(offset); it != branches.end()) {
+					outputFile << "; taken " << it->second->taken << ", not taken " << it->second->notTaken;
+				}
+				outputFile << "\n";
 			}
 		}
+		return 0;
+	}
+
+	program.goto_(bytecode::FIRST_INSTR_ADDR_LOCATION);
+	program.goto_(*reinterpret_cast<types::word_t*>(program.pos()));
+
+	while (program.inBounds()) {
+		writeInstruction(program, outputFile);
 		outputFile << "\n";
 	}
 
@@ -13,6 +13,8 @@ namespace disassembler {
 	// Holds settings info about the disassembly process
 	struct DisassemblerSettings {
 		Flags flags;
+		// Coverage from the executor's --coverage, to disassemble block by block with how often each ran, or null
+		const char* coveragePath = nullptr;
 	};
 
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -25,6 +27,7 @@ namespace disassembler {
 			INVALID_OPCODE,
 			INVALID_WORD_REG,
 			INVALID_BYTE_REG,
+			BAD_COVERAGE,
 			Count
 		};
 
@@ -32,7 +35,8 @@ namespace disassembler {
 		static constexpr const char* const errorTypeStrings[] = {
 			"Invalid opcode",
 			"Invalid word register",
-			"Invalid byte register"
+			"Invalid byte register",
+			"Invalid coverage file"
 		};
 
 		ErrorType eType;
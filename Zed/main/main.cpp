@@ -2,8 +2,13 @@
 #include "../assembler/assembler.h"
 #include "../disassembler/disassembler.h"
 #include "../vm/executor.h"
+#include "../vm/batch.h"
+#include "../vm/pipeline.h"
+#include "../vm/metrics.h"
 #include "../compiler/compiler.h"
 #include "argparse.h"
+#include <iomanip>
+#include <sstream>
 
 #define CHECK_ARGS(str) if (argc - i < 1) {cout << IO_ERR "Not enough arguments for " str IO_NORM IO_END;return 1;}
 #define ERR(str) std::cout << IO_ERR str IO_NORM IO_END; return 1
@@ -23,13 +28,134 @@ static int commandDefault(const argparse::Command& c, Flags& globalFlags) {
 	return 0;
 }
 
+// Handles the options shared by every command that runs executables
+// Returns 0 if the option was used, 1 if it was invalid, and -1 if it isn't one of these options
+static int parseExecutorOption(const argparse::Option& o, executor::ExecutorSettings& settings) {
+	if (o.getName() == "-s" || o.getName() == "--stacksize") {
+		if (o.getArgs().empty()) {
+			ERR("Option --stacksize is missing an argument");
+		}
+		try {
+			settings.stackSize = std::stol(o.getArgs().front());
+			if (settings.stackSize <= 0) {
+				ERR("Invalid stack size");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid stack size");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid stack size");
+		}
+	} else if (o.getName() == "--task-stack") {
+		if (o.getArgs().empty()) {
+			ERR("Option --task-stack is missing an argument");
+		}
+		try {
+			settings.taskStackSize = std::stoi(o.getArgs().front());
+			if (settings.taskStackSize < 64) {
+				ERR("Invalid task stack size");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid task stack size");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid task stack size");
+		}
+	} else if (o.getName() == "--heapsize") {
+		if (o.getArgs().empty()) {
+			ERR("Option --heapsize is missing an argument");
+		}
+		try {
+			settings.heapSize = std::stoi(o.getArgs().front());
+			if (settings.heapSize <= 0) {
+				ERR("Invalid heap size");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid heap size");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid heap size");
+		}
+	} else if (o.getName() == "--workers") {
+		if (o.getArgs().empty()) {
+			ERR("Option --workers is missing an argument");
+		}
+		try {
+			settings.workers = std::stoi(o.getArgs().front());
+			if (settings.workers <= 0) {
+				ERR("Invalid worker count");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid worker count");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid worker count");
+		}
+	} else if (o.getName() == "--io-workers") {
+		if (o.getArgs().empty()) {
+			ERR("Option --io-workers is missing an argument");
+		}
+		try {
+			settings.ioWorkers = std::stoi(o.getArgs().front());
+			if (settings.ioWorkers <= 0) {
+				ERR("Invalid worker count");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid worker count");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid worker count");
+		}
+	} else if (o.getName() == "--segment-dir") {
+		if (o.getArgs().empty()) {
+			ERR("Option --segment-dir is missing an argument");
+		}
+		settings.segmentDir = o.getArgs().front().c_str();
+	} else if (o.getName() == "-m" || o.getName() == "--memcheck") {
+		settings.flags.setFlags(executor::FLAG_CHECK_MEM);
+	} else if (o.getName() == "--trace") {
+		settings.flags.setFlags(executor::FLAG_TRACE);
+	} else if (o.getName() == "--profile-opcodes") {
+		settings.flags.setFlags(executor::FLAG_PROFILE_OPCODES);
+	} else if (o.getName() == "--profile-heap") {
+		settings.flags.setFlags(executor::FLAG_PROFILE_HEAP);
+	} else if (o.getName() == "--max-instructions") {
+		if (o.getArgs().empty()) {
+			ERR("Option --max-instructions is missing an argument");
+		}
+		try {
+			settings.maxInstructions = std::stoll(o.getArgs().front());
+			if (settings.maxInstructions <= 0) {
+				ERR("Invalid instruction limit");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid instruction limit");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid instruction limit");
+		}
+	} else if (o.getName() == "--timeout-ms") {
+		if (o.getArgs().empty()) {
+			ERR("Option --timeout-ms is missing an argument");
+		}
+		try {
+			settings.timeoutMs = std::stoll(o.getArgs().front());
+			if (settings.timeoutMs <= 0) {
+				ERR("Invalid timeout");
+			}
+		} catch (const std::invalid_argument&) {
+			ERR("Invalid timeout");
+		} catch (const std::out_of_range&) {
+			ERR("Invalid timeout");
+		}
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
 static int commandExecute(const argparse::Command& c, const Flags& globalFlags) {
 	executor::ExecutorSettings settings;
 	settings.flags.setFlags(globalFlags);
 
 	const std::string* inputPath = nullptr;
-
-	char res = 'X';
+	const std::string* restorePath = nullptr;
+	const std::string* resumePath = nullptr;
+	const std::string* replayPath = nullptr;
 
 	for (const argparse::Option& o : c.getOptions()) {
 		if (o.getName() == argparse::DEFAULT) {
@@ -45,42 +171,131 @@ static int commandExecute(const argparse::Command& c, const Flags& globalFlags)
 			} else {
 				ERR("Option --in is missing an argument");
 			}
-		} else if (o.getName() == "-s" || o.getName() == "--stacksize") {
+		} else if (o.getName() == "--snapshot") {
+			if (!o.getArgs().empty()) {
+				settings.snapshotPath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --snapshot is missing an argument");
+			}
+		} else if (o.getName() == "--restore") {
+			if (!o.getArgs().empty()) {
+				restorePath = &o.getArgs().front();
+			} else {
+				ERR("Option --restore is missing an argument");
+			}
+		} else if (o.getName() == "--checkpoint") {
+			if (!o.getArgs().empty()) {
+				settings.checkpointPath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --checkpoint is missing an argument");
+			}
+		} else if (o.getName() == "--checkpoint-ms") {
 			if (o.getArgs().empty()) {
-				ERR("Option --stacksize is missing an argument");
+				ERR("Option --checkpoint-ms is missing an argument");
 			}
 			try {
-				settings.stackSize = std::stol(o.getArgs().front());
-				if (settings.stackSize <= 0) {
-					ERR("Invalid stack size");
+				settings.checkpointMs = std::stoll(o.getArgs().front());
+				if (settings.checkpointMs <= 0) {
+					ERR("Invalid checkpoint interval");
 				}
-				if (settings.stackSize < 256 || settings.stackSize > 512000000) {
-					if (settings.stackSize < 256) {
-						std::cout << "Are you sure you want your stack size to be " << settings.stackSize << " bytes? (That's really small)\n";
-					} else {
-						std::cout << "Are you sure you want your stack size to be " << settings.stackSize << " bytes? (That's really big - over 512 MB)\n";
-					}
-					while (true) {
-						std::cout << "(Y/N): ";
-						std::cin >> res;
-						std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-						if (res == 'Y' || res == 'y') {
-							break;
-						} else if (res == 'N' || res == 'n') {
-							ERR("Aborted stack size choice");
-						}
-					}
+			} catch (const std::invalid_argument&) {
+				ERR("Invalid checkpoint interval");
+			} catch (const std::out_of_range&) {
+				ERR("Invalid checkpoint interval");
+			}
+		} else if (o.getName() == "--resume") {
+			if (!o.getArgs().empty()) {
+				resumePath = &o.getArgs().front();
+			} else {
+				ERR("Option --resume is missing an argument");
+			}
+		} else if (o.getName() == "--sample-hz") {
+			if (o.getArgs().empty()) {
+				ERR("Option --sample-hz is missing an argument");
+			}
+			try {
+				settings.sampleHz = std::stoi(o.getArgs().front());
+				if (settings.sampleHz <= 0 || settings.sampleHz > 1000000) {
+					ERR("Invalid sampling rate");
 				}
 			} catch (const std::invalid_argument&) {
-				ERR("Invalid stack size");
+				ERR("Invalid sampling rate");
 			} catch (const std::out_of_range&) {
-				ERR("Invalid stack size");
+				ERR("Invalid sampling rate");
 			}
-		} else if (o.getName() == "-m" || o.getName() == "--memcheck") {
-			settings.flags.setFlags(executor::FLAG_CHECK_MEM);
+		} else if (o.getName() == "--sample-out") {
+			if (!o.getArgs().empty()) {
+				settings.samplePath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --sample-out is missing an argument");
+			}
+		} else if (o.getName() == "--symbols") {
+			if (!o.getArgs().empty()) {
+				settings.symbolsPath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --symbols is missing an argument");
+			}
+		} else if (o.getName() == "--coverage") {
+			if (!o.getArgs().empty()) {
+				settings.coveragePath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --coverage is missing an argument");
+			}
+		} else if (o.getName() == "--record") {
+			if (!o.getArgs().empty()) {
+				settings.recordPath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --record is missing an argument");
+			}
+		} else if (o.getName() == "--replay") {
+			if (!o.getArgs().empty()) {
+				replayPath = &o.getArgs().front();
+			} else {
+				ERR("Option --replay is missing an argument");
+			}
+		} else if (o.getName() == "--metrics") {
+			settings.metricsInterval = executor::DEFAULT_METRICS_INTERVAL;
+			if (o.getArgs().empty()) continue;
+			try {
+				settings.metricsInterval = std::stoll(o.getArgs().front());
+				if (settings.metricsInterval <= 0) {
+					ERR("Invalid metrics interval");
+				}
+			} catch (const std::invalid_argument&) {
+				ERR("Invalid metrics interval");
+			} catch (const std::out_of_range&) {
+				ERR("Invalid metrics interval");
+			}
+		} else if (parseExecutorOption(o, settings) > 0) {
+			return 1;
 		}
 	}
 
+	// Samples go next to whatever is being run, unless told to go somewhere else
+	std::string samplePath;
+	const std::string* const runPath = replayPath ? replayPath : resumePath ? resumePath : restorePath ? restorePath : inputPath;
+	if (settings.sampleHz > 0 && !settings.samplePath && runPath) {
+		samplePath = *runPath + ".folded";
+		settings.samplePath = samplePath.c_str();
+	}
+
+	if (replayPath) {
+		if (settings.recordPath) {
+			ERR("Can't record a replay");
+		}
+		return executor::replay(replayPath->c_str(), settings);
+	}
+
+	if (resumePath) {
+		// Carry on checkpointing where it left off, unless told to put them somewhere else
+		if (!settings.checkpointPath) settings.checkpointPath = resumePath->c_str();
+		return executor::restore(resumePath->c_str(), settings);
+	}
+
+	if (restorePath) {
+		return executor::restore(restorePath->c_str(), settings);
+	}
+
 	if (!inputPath) {
 		ERR("Missing input path for execution");
 	}
@@ -88,6 +303,120 @@ static int commandExecute(const argparse::Command& c, const Flags& globalFlags)
 	return executor::exec(inputPath->c_str(), settings);
 }
 
+static int commandBatch(const argparse::Command& c, const Flags& globalFlags) {
+	executor::BatchSettings settings;
+	settings.exec.flags.setFlags(globalFlags);
+
+	const std::string* manifestPath = nullptr;
+
+	for (const argparse::Option& o : c.getOptions()) {
+		if (o.getName() == argparse::DEFAULT) {
+			if (!o.getArgs().empty()) manifestPath = &o.getArgs().front();
+		} else if (o.getName() == "-h" || o.getName() == "--help") {
+			std::cout << batchHelp;
+			return 0;
+		} else if (o.getName() == "-d" || o.getName() == "--debug") {
+			settings.exec.flags.setFlags(Flags::FLAG_DEBUG);
+		} else if (o.getName() == "-i" || o.getName() == "--in") {
+			if (!o.getArgs().empty()) {
+				manifestPath = &o.getArgs().front();
+			} else {
+				ERR("Option --in is missing an argument");
+			}
+		} else if (o.getName() == "-j" || o.getName() == "--jobs") {
+			if (o.getArgs().empty()) {
+				ERR("Option --jobs is missing an argument");
+			}
+			try {
+				settings.threads = std::stoi(o.getArgs().front());
+				if (settings.threads <= 0) {
+					ERR("Invalid thread count");
+				}
+			} catch (const std::invalid_argument&) {
+				ERR("Invalid thread count");
+			} catch (const std::out_of_range&) {
+				ERR("Invalid thread count");
+			}
+		} else if (o.getName() == "-r" || o.getName() == "--report") {
+			if (!o.getArgs().empty()) {
+				settings.reportPath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --report is missing an argument");
+			}
+		} else if (parseExecutorOption(o, settings.exec) > 0) {
+			return 1;
+		}
+	}
+
+	if (!manifestPath) {
+		ERR("Missing manifest path for batch");
+	}
+
+	return executor::batch(manifestPath->c_str(), settings);
+}
+
+static int commandPipeline(const argparse::Command& c, const Flags& globalFlags) {
+	executor::ExecutorSettings settings;
+	settings.flags.setFlags(globalFlags);
+
+	const std::string* topologyPath = nullptr;
+	const std::vector<std::string>* chain = nullptr;
+	int capacity = executor::DEFAULT_CHANNEL_CAPACITY;
+
+	for (const argparse::Option& o : c.getOptions()) {
+		if (o.getName() == argparse::DEFAULT) {
+			if (!o.getArgs().empty()) topologyPath = &o.getArgs().front();
+		} else if (o.getName() == "-h" || o.getName() == "--help") {
+			std::cout << pipelineHelp;
+			return 0;
+		} else if (o.getName() == "-d" || o.getName() == "--debug") {
+			settings.flags.setFlags(Flags::FLAG_DEBUG);
+		} else if (o.getName() == "--chain") {
+			if (o.getArgs().size() < 2) {
+				ERR("Option --chain needs at least two programs");
+			}
+			chain = &o.getArgs();
+		} else if (o.getName() == "--capacity") {
+			if (o.getArgs().empty()) {
+				ERR("Option --capacity is missing an argument");
+			}
+			try {
+				capacity = std::stoi(o.getArgs().front());
+				if (capacity <= 0) {
+					ERR("Invalid channel capacity");
+				}
+			} catch (const std::invalid_argument&) {
+				ERR("Invalid channel capacity");
+			} catch (const std::out_of_range&) {
+				ERR("Invalid channel capacity");
+			}
+		} else if (parseExecutorOption(o, settings) > 0) {
+			return 1;
+		}
+	}
+
+	if (chain) {
+		// Each stage receives on port 0 from the one before, and sends on port 1 to the one after
+		std::stringstream topology;
+		for (size_t i = 1; i < chain->size(); i++) {
+			topology << "channel c" << i << ' ' << capacity << '\n';
+		}
+		for (size_t i = 0; i < chain->size(); i++) {
+			topology << "isolate " << std::quoted((*chain)[i]);
+			if (i > 0) topology << " 0<c" << i;
+			if (i + 1 < chain->size()) topology << " 1>c" << i + 1;
+			topology << '\n';
+		}
+		return executor::pipeline_(topology, settings, std::cout);
+	}
+
+	if (!topologyPath) {
+		ERR("Missing topology path for pipeline");
+	}
+
+	return executor::pipeline(topologyPath->c_str(), settings);
+}
+
 static int commandAssemble(const argparse::Command& c, const Flags& globalFlags) {
 	assembler::AssemblerSettings settings;
 	settings.flags.setFlags(globalFlags);
@@ -116,6 +445,12 @@ static int commandAssemble(const argparse::Command& c, const Flags& globalFlags)
 			} else {
 				ERR("Option --out is missing an argument");
 			}
+		} else if (o.getName() == "--symbols") {
+			if (o.getArgs().size() > 0) {
+				settings.symbolsPath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --symbols is missing an argument");
+			}
 		}
 	}
 
@@ -154,6 +489,12 @@ static int commandDisassemble(const argparse::Command& c, const Flags& globalFla
 			} else {
 				ERR("Option --out is missing an argument");
 			}
+		} else if (o.getName() == "--coverage") {
+			if (o.getArgs().size() > 0) {
+				settings.coveragePath = o.getArgs().front().c_str();
+			} else {
+				ERR("Option --coverage is missing an argument");
+			}
 		}
 	}
 
@@ -220,6 +561,37 @@ static int commandCompile(const argparse::Command& c, const Flags& globalFlags)
 	return compiler::compile(inputPath->c_str(), outputPath->c_str(), settings);
 }
 
+static int commandStat(const argparse::Command& c) {
+	const std::string* pidArg = nullptr;
+
+	for (const argparse::Option& o : c.getOptions()) {
+		if (o.getName() == argparse::DEFAULT) {
+			if (!o.getArgs().empty()) pidArg = &o.getArgs().front();
+		} else if (o.getName() == "-h" || o.getName() == "--help") {
+			std::cout << statHelp;
+			return 0;
+		}
+	}
+
+	if (!pidArg) {
+		ERR("Missing process id for stat");
+	}
+
+	int pid;
+	try {
+		pid = std::stoi(*pidArg);
+		if (pid <= 0) {
+			ERR("Invalid process id");
+		}
+	} catch (const std::invalid_argument&) {
+		ERR("Invalid process id");
+	} catch (const std::out_of_range&) {
+		ERR("Invalid process id");
+	}
+
+	return executor::stat(pid, std::cout);
+}
+
 int main(const int argc, const char* argv[]) {
 	using namespace std;
 
@@ -237,12 +609,18 @@ int main(const int argc, const char* argv[]) {
 			out = commandDefault(c, globalFlags);
 		} else if (c.getName() == "/execute" || c.getName() == "/e") {
 			out = commandExecute(c, globalFlags);
+		} else if (c.getName() == "/batch" || c.getName() == "/b") {
+			out = commandBatch(c, globalFlags);
+		} else if (c.getName() == "/pipeline" || c.getName() == "/p") {
+			out = commandPipeline(c, globalFlags);
 		} else if (c.getName() == "/assemble" || c.getName() == "/a") {
 			out = commandAssemble(c, globalFlags);
 		} else if (c.getName() == "/disassemble" || c.getName() == "/d") {
 			out = commandDisassemble(c, globalFlags);
 		} else if (c.getName() == "/compile" || c.getName() == "/c") {
 			out = commandCompile(c, globalFlags);
+		} else if (c.getName() == "/stat" || c.getName() == "/s") {
+			out = commandStat(c);
 		} else {
 			cout << IO_WARN "Unknown command: " << c.getName() << " " IO_NORM "\n";
 		}
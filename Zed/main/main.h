@@ -18,14 +18,69 @@ constexpr const char* mainHelp =
 "    -h, --help          display this help information\n"
 "    -d, --debug         set debug mode for all following commands\n"
 "    /e, /execute        execute a .eze executable\n"
+"    /b, /batch          execute many .eze executables in parallel, from a manifest\n"
+"    /p, /pipeline       execute .eze executables as isolates connected by channels\n"
 "    /a, /assemble       assemble a .azm file into a .eze executable\n"
 "    /d, /disassemble    disassemble a .eze executable\n"
 "    /c, /compile        compile a .z file into a .eze executable\n"
+"    /s, /stat           show what a running /execute --metrics is doing\n"
 "\n"
 "For specific command help, use the help option under the command.\n"
 "    Example: zed.exe /compile --help\n";
 
 constexpr const char* executeHelp = "TODO\n";
+constexpr const char* batchHelp =
+"Batch Help\n"
+"==========\n"
+"Usage: zed.exe /batch [manifest] [options]\n"
+"Each line of the manifest is a job: a .eze file, a file to read its input from, and a file to write its output to.\n"
+"Paths can be quoted, \"-\" means no input or no output, and lines starting with ';' are comments.\n"
+"Options:\n"
+"    -h, --help                  display this help information\n"
+"    -d, --debug                 show each job's timing\n"
+"    -j, --jobs [n]              run on n threads (default: one per core)\n"
+"    -r, --report [path]         write every job's exit code and timing to a file\n"
+"    -s, --stacksize [bytes]     stack size for each job\n"
+"    --task-stack [bytes]        stack size for each task a job spawns\n"
+"    --heapsize [bytes]          heap size for each job\n"
+"    --segment-dir [path]        where popen finds persistent segments (default: the current directory)\n"
+"    --workers [n]               threads for each job's parfor loops (default: one per core)\n"
+"    --io-workers [n]            threads for each job's aioread and aiowrite requests (default: 4)\n"
+"    --trace                     print every instruction each job runs, before running it\n"
+"    --max-instructions [n]      stop each job after about n instructions\n"
+"    --timeout-ms [n]            stop each job after n milliseconds\n";
+constexpr const char* pipelineHelp =
+"Pipeline Help\n"
+"=============\n"
+"Usage: zed.exe /pipeline [topology] [options]\n"
+"   or: zed.exe /pipeline --chain [first.eze] [second.eze] ... [options]\n"
+"Runs each .eze file as an isolate on its own thread, sharing nothing but channels, used with chansend and chanrecv.\n"
+"Each line of the topology is either \"channel [name] [capacity]\" or \"isolate [.eze file] [bindings...]\",\n"
+"where a binding like 1>out sends on port 1 into channel out, and 0<in receives on port 0 from channel in.\n"
+"With --chain, each program receives on port 0 from the one before it and sends on port 1 to the one after it.\n"
+"Options:\n"
+"    -h, --help                  display this help information\n"
+"    -d, --debug                 show how the isolates were wired\n"
+"    --chain [programs...]       run the programs as a straight pipeline, instead of reading a topology\n"
+"    --capacity [words]          capacity of each channel made by --chain (default: 1024)\n"
+"    -s, --stacksize [bytes]     stack size for each isolate\n"
+"    --task-stack [bytes]        stack size for each task an isolate spawns\n"
+"    --heapsize [bytes]          heap size for each isolate\n"
+"    --segment-dir [path]        where popen finds persistent segments (default: the current directory)\n"
+"    --workers [n]               threads for each isolate's parfor loops (default: one per core)\n"
+"    --io-workers [n]            threads for each isolate's aioread and aiowrite requests (default: 4)\n"
+"    --trace                     print every instruction each isolate runs, before running it\n"
+"    --max-instructions [n]      stop each isolate after about n instructions\n"
+"    --timeout-ms [n]            stop each isolate after n milliseconds\n";
+constexpr const char* statHelp =
+"Stat Help\n"
+"=========\n"
+"Usage: zed.exe /stat [pid]\n"
+"Shows the metrics last published by the process pid, which has to be running /execute --metrics [n].\n"
+"It publishes every n instructions on each thread, without pausing the program, and /stat only reads them.\n"
+"Labels are only shown if it was also given --symbols.\n"
+"Options:\n"
+"    -h, --help                  display this help information\n";
 constexpr const char* assembleHelp = "TODO\n";
 constexpr const char* disassembleHelp = "TODO\n";
 constexpr const char* compileHelp = "TODO\n";
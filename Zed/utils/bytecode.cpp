@@ -1,25 +1,93 @@
 #include "bytecode.h"
 #include <iostream>
+#include <algorithm>
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Program
 
-bytecode::Program::Program(std::iostream& program) {
+// Finds the length of a whole stream
+static std::streamsize streamLength(std::iostream& stream) {
 	// https://stackoverflow.com/questions/22984956/tellg-function-give-wrong-size-of-file
-	program.seekg(0, std::ios::beg);
-	program.ignore(std::numeric_limits<std::streamsize>::max());
-	const std::streamsize length = program.gcount();
+	stream.seekg(0, std::ios::beg);
+	stream.ignore(std::numeric_limits<std::streamsize>::max());
+	const std::streamsize length = stream.gcount();
 
+	stream.clear();
+	stream.seekg(0, std::ios::beg);
+	return length;
+}
+
+void bytecode::Image::allocate() {
+	shared = vmem::createShared(mapSize());
+	if (shared == vmem::NO_SHARED) throw std::bad_alloc();
+
+	bytes = vmem::mapShared(shared, mapSize());
+	if (!bytes) {
+		vmem::closeShared(shared);
+		throw std::bad_alloc();
+	}
+
+	std::fill_n(bytes + length, Program::FILLER_SIZE, bytecode::Opcode::HALT);
+}
+
+bytecode::Image::Image(std::iostream& file) : shared(vmem::NO_SHARED), bytes(nullptr), length(static_cast<int>(streamLength(file))) {
+	allocate();
+	file.read(bytes, length);
+}
+
+bytecode::Image::Image(std::istream& in, const int length) : shared(vmem::NO_SHARED), bytes(nullptr), length(length) {
+	allocate();
+	in.read(bytes, length);
+}
+
+bytecode::Image::~Image() {
+	vmem::unmapFile(bytes, mapSize());
+	vmem::closeShared(shared);
+}
+
+const char* bytecode::Image::data() const noexcept {
+	return bytes;
+}
+
+int bytecode::Image::size() const noexcept {
+	return length;
+}
+
+char* bytecode::Image::map(char* const at) const noexcept {
+	return vmem::mapCopy(shared, mapSize(), at);
+}
+
+size_t bytecode::Image::mapSize() const noexcept {
+	return static_cast<size_t>(length) + Program::FILLER_SIZE;
+}
+
+void bytecode::Program::allocate(const int length) {
 	owner = std::make_unique<char[]>(static_cast<size_t>(length) + FILLER_SIZE);
 	start = owner.get();
 	ip = start;
 	end = start + length;
 
-	program.clear();
-	program.seekg(0, std::ios::beg);
+	std::fill_n(start + length, FILLER_SIZE, bytecode::Opcode::HALT);
+}
+
+bytecode::Program::Program(std::iostream& program) : mapping(nullptr) {
+	const std::streamsize length = streamLength(program);
+	allocate(static_cast<int>(length));
 	program.read(start, length);
+}
 
-	std::fill_n(start + length, FILLER_SIZE, bytecode::Opcode::HALT);
+bytecode::Program::Program(const Image& image, char* const at) : mapping(image.map(at)) {
+	if (!mapping) throw std::bad_alloc();
+	start = mapping;
+	ip = start;
+	end = start + image.size();
+}
+
+bytecode::Program::Program(const Program& shared, const types::word_t loc) noexcept
+	: mapping(nullptr), start(shared.start), ip(shared.start + loc), end(shared.end) {}
+
+bytecode::Program::~Program() {
+	vmem::unmapFile(mapping, end - start + FILLER_SIZE);
 }
 
 char* bytecode::Program::pos() const noexcept {
@@ -34,6 +102,10 @@ int bytecode::Program::offset() const noexcept {
 	return ip - start;
 }
 
+int bytecode::Program::size() const noexcept {
+	return end - start;
+}
+
 bool bytecode::Program::inBounds() const noexcept {
 	return start <= ip && ip < end;
 }
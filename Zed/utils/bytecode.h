@@ -1,8 +1,10 @@
 #pragma once
 #include "opcode.h"
+#include "vmem.h"
 #include <cstdint>
 #include <span>
 #include <memory>
+#include <string_view>
 
 
 namespace bytecode {
@@ -12,6 +14,16 @@ namespace bytecode {
 	constexpr int FIRST_INSTR_ADDR_LOCATION = 0;
 	constexpr int GLOBAL_TABLE_LOCATION = 4;
 
+	// What NATIVE holds instead of a native function's name, since the functions are only known once a program is running
+	// The 32-bit FNV-1a hash of the name
+	constexpr uint32_t nativeId(const std::string_view name) noexcept {
+		uint32_t hash = 0x811C9DC5;
+		for (const char c : name) {
+			hash = (hash ^ static_cast<uint8_t>(c)) * 0x01000193;
+		}
+		return hash;
+	}
+
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Types (could maybe be its own file)
 
@@ -91,25 +103,103 @@ namespace bytecode {
 	static_assert(sizeof(regStrings) / sizeof(const char*) == namedRegCount,
 				  "Number of register strings does not match list of register strings");
 
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Instructions
+
+	// How many bytes an instruction takes, opcode included, or 0 for an opcode that can't be run
+	constexpr int instructionSize(const types::opcode_t opcode) noexcept {
+		if (opcode >= Opcode::ValidCount) return 0;
+
+		int size = sizeof(types::opcode_t);
+		for (const int arg : opcodeArgs[opcode]) {
+			switch (static_cast<OpcodeArgType>(arg)) {
+				case OpcodeArgType::ARG_WORD_REG:
+				case OpcodeArgType::ARG_BYTE_REG:
+					size += sizeof(types::reg_t);
+					break;
+				case OpcodeArgType::ARG_WORD:
+				case OpcodeArgType::ARG_NATIVE:
+					size += sizeof(types::word_t);
+					break;
+				case OpcodeArgType::ARG_BYTE:
+					size += sizeof(types::byte_t);
+					break;
+				default:
+					break;
+			}
+		}
+		return size;
+	}
+
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Program
 
+	// The bytes of a .eze file, read once and never modified
+	// Any number of programs, on any number of threads, can be made from one image without touching the file again
+	// The bytes are kept in shared memory, so that programs can map them copy-on-write instead of copying them
+	class Image {
+	private:
+		vmem::Shared shared;
+		char* bytes;
+		int length;
+
+		// Makes the shared memory, with room for the program's filler after the bytes
+		void allocate();
+
+	public:
+		explicit Image(std::iostream& file);
+		// Reads length bytes from the current position of a stream
+		Image(std::istream& in, const int length);
+		~Image();
+
+		Image(const Image&) = delete;
+		Image& operator=(const Image&) = delete;
+
+		[[nodiscard]] const char* data() const noexcept;
+		[[nodiscard]] int size() const noexcept;
+
+		// Maps a copy-on-write copy of the bytes and the filler after them, exactly at at if it isn't null
+		// Returns nullptr if it can't
+		[[nodiscard]] char* map(char* const at) const noexcept;
+		// The size of what map maps
+		[[nodiscard]] size_t mapSize() const noexcept;
+	};
+
 	// A .eze program loaded into memory
 	class Program {
-	private:
+	public:
+		// HALTs after the end of the program, so a truncated instruction stops instead of reading past it
 		static constexpr int FILLER_SIZE = 24;
+
+	private:
 		std::unique_ptr<char[]> owner;
+		// From Image::map, or null
+		char* mapping;
 		char* start;
 		char* ip;
 		char* end;
 
+		void allocate(const int length);
+
 	public:
 
 		explicit Program(std::iostream& program);
+		// Copies an image, since a running program writes its globals into its own bytes
+		// The copy is copy-on-write, so programs made from the same image share every page they haven't written to
+		// If at isn't null the copy goes exactly there, and std::bad_alloc is thrown if it can't
+		explicit Program(const Image& image, char* const at = nullptr);
+		// Another instruction pointer into the bytes of an existing program, starting at loc. For guest threads,
+		// which share code and globals. Owns nothing, so it must not outlive the program it came from
+		Program(const Program& shared, const types::word_t loc) noexcept;
+		~Program();
+
+		Program(const Program&) = delete;
+		Program& operator=(const Program&) = delete;
 
 		[[nodiscard]] char* pos() const noexcept;
 		[[nodiscard]] char* begin() const noexcept;
 		[[nodiscard]] int offset() const noexcept;
+		[[nodiscard]] int size() const noexcept;
 		[[nodiscard]] bool inBounds() const noexcept;
 
 		void goto_(const types::word_t loc) noexcept;
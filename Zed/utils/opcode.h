@@ -96,6 +96,60 @@ namespace bytecode {
 			TIME,
 			// 
 			//
+			SPAWN,
+			JOIN,
+			//
+			XADD,
+			CMPXCHG,
+			LOAD_ACQ_W,
+			STORE_REL_W,
+			//
+			YIELD,
+			TASK_SPAWN,
+			TASK_WAIT,
+			//
+			CHAN_SEND,
+			CHAN_RECV,
+			//
+			PARFOR,
+			//
+			SNAPSHOT,
+			//
+			P_OPEN,
+			P_ALLOC,
+			//
+			FILE_OPEN,
+			FILE_SIZE,
+			FILE_MAP,
+			FILE_SYNC,
+			FILE_UNMAP,
+			FILE_CLOSE,
+			//
+			AIO_READ,
+			AIO_WRITE,
+			AIO_POLL,
+			AIO_WAIT,
+			//
+			NATIVE,
+			//
+			I_SORT,
+			F_SORT,
+			I_LOWER,
+			F_LOWER,
+			HASH,
+			RAND_SEED,
+			RAND,
+			//
+			I_PARSE,
+			F_PARSE,
+			I_FORMAT,
+			F_FORMAT,
+			//
+			CLOCK_NS,
+			INSTR_COUNT,
+			BENCH_BEGIN,
+			BENCH_END,
+			//
 			//
 			GLOBAL_W,
 			GLOBAL_B,
@@ -203,6 +257,60 @@ namespace bytecode {
 		"time",
 		// 
 		//
+		"spawn",
+		"join",
+		//
+		"xadd",
+		"cmpxchg",
+		"loadacqw",
+		"storerelw",
+		//
+		"yield",
+		"taskspawn",
+		"taskwait",
+		//
+		"chansend",
+		"chanrecv",
+		//
+		"parfor",
+		//
+		"snapshot",
+		//
+		"popen",
+		"palloc",
+		//
+		"fileopen",
+		"filesize",
+		"filemap",
+		"filesync",
+		"fileunmap",
+		"fileclose",
+		//
+		"aioread",
+		"aiowrite",
+		"aiopoll",
+		"aiowait",
+		//
+		"native",
+		//
+		"isort",
+		"fsort",
+		"ilower",
+		"flower",
+		"hash",
+		"rseed",
+		"rand",
+		//
+		"iparse",
+		"fparse",
+		"iformat",
+		"fformat",
+		//
+		"clockns",
+		"instret",
+		"benchbegin",
+		"benchend",
+		//
 		//
 		"globalw",
 		"globalb",
@@ -212,7 +320,8 @@ namespace bytecode {
 	static_assert(sizeof(opcodeStrings) / sizeof(const char*) == opcodeCount,
 				  "Number of opcodes does not match list of opcodes");
 
-	constexpr int OPCODE_MAX_ARGS = 3;
+	// Only the number parsing and formatting opcodes use the fourth
+	constexpr int OPCODE_MAX_ARGS = 4;
 	enum class OpcodeArgType {
 		ARG_NONE,		// 0
 		ARG_WORD_REG,	// 1
@@ -220,7 +329,8 @@ namespace bytecode {
 		ARG_WORD,		// 3 (Also processes labels)
 		ARG_BYTE,		// 4
 		ARG_VAR,		// 5 (Only for setting vars, use ARG_WORD for reading them)
-		ARG_STR			// 6
+		ARG_STR,		// 6
+		ARG_NATIVE		// 7 (A native function's @name, written as a word by bytecode::nativeId)
 	};
 	// A list of the arguments for each opcode
 	constexpr int opcodeArgs[][OPCODE_MAX_ARGS] = {
@@ -314,7 +424,61 @@ namespace bytecode {
 		//
 		{1, 0, 0},	// TIME
 		// 
-		// 
+		//
+		{1, 3, 1},	// SPAWN
+		{1, 1, 0},	// JOIN
+		//
+		{1, 1, 1},	// XADD
+		{1, 1, 1},	// CMPXCHG
+		{1, 1, 3},	// LOAD_ACQ_W
+		{1, 3, 1},	// STORE_REL_W
+		//
+		{0, 0, 0},	// YIELD
+		{1, 3, 1},	// TASK_SPAWN
+		{1, 1, 0},	// TASK_WAIT
+		//
+		{3, 1, 0},	// CHAN_SEND
+		{1, 3, 0},	// CHAN_RECV
+		//
+		{3, 1, 1},	// PARFOR
+		//
+		{0, 0, 0},	// SNAPSHOT
+		//
+		{1, 1, 1},	// P_OPEN
+		{1, 1, 1},	// P_ALLOC
+		//
+		{1, 1, 1},	// FILE_OPEN
+		{1, 1, 1},	// FILE_SIZE
+		{1, 1, 1},	// FILE_MAP
+		{1, 0, 0},	// FILE_SYNC
+		{1, 0, 0},	// FILE_UNMAP
+		{1, 0, 0},	// FILE_CLOSE
+		//
+		{1, 1, 1},	// AIO_READ
+		{1, 1, 1},	// AIO_WRITE
+		{1, 1, 0},	// AIO_POLL
+		{1, 1, 0},	// AIO_WAIT
+		//
+		{7, 0, 0},	// NATIVE
+		//
+		{1, 1, 0},	// I_SORT
+		{1, 1, 0},	// F_SORT
+		{1, 1, 1},	// I_LOWER
+		{1, 1, 1},	// F_LOWER
+		{1, 1, 1},	// HASH
+		{1, 1, 0},	// RAND_SEED
+		{1, 1, 0},	// RAND
+		//
+		{1, 1, 1, 1},	// I_PARSE
+		{1, 1, 1},		// F_PARSE
+		{1, 1, 1, 1},	// I_FORMAT
+		{1, 1, 1},		// F_FORMAT
+		//
+		{1, 1, 0},	// CLOCK_NS
+		{1, 1, 0},	// INSTR_COUNT
+		{3, 0, 0},	// BENCH_BEGIN
+		{3, 0, 0},	// BENCH_END
+		//
 		//
 		{5, 3, 0},	// GLOBAL_W
 		{5, 4, 0},	// GLOBAL_B
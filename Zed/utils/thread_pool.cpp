@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Thread Pool
+
+namespace {
+	// Which pool and worker the calling thread belongs to, if any
+	thread_local const ThreadPool* currentPool = nullptr;
+	thread_local int currentId = -1;
+}
+
+ThreadPool::ThreadPool(const int threadCount) : pending(0), queued(0), nextWorker(0), stopping(false) {
+	int count = threadCount > 0 ? threadCount : static_cast<int>(std::thread::hardware_concurrency());
+	if (count <= 0) count = 1;
+
+	for (int i = 0; i < count; i++) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+	for (int i = 0; i < count; i++) {
+		threads.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	wait();
+	{
+		const std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(Task task) {
+	++pending;
+
+	const size_t id = currentPool == this ? static_cast<size_t>(currentId) : nextWorker++ % workers.size();
+	{
+		const std::lock_guard<std::mutex> lock(workers[id]->mutex);
+		workers[id]->tasks.push_back(std::move(task));
+	}
+	++queued;
+
+	{
+		const std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(sleepMutex);
+	idle.wait(lock, [this] { return pending == 0; });
+}
+
+int ThreadPool::size() const noexcept {
+	return static_cast<int>(workers.size());
+}
+
+int ThreadPool::currentWorker() const noexcept {
+	return currentPool == this ? currentId : -1;
+}
+
+bool ThreadPool::tryPop(const int id, Task& task) {
+	Worker& worker = *workers[id];
+	const std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty()) return false;
+
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	--queued;
+	return true;
+}
+
+bool ThreadPool::trySteal(const int id, Task& task) {
+	const int count = size();
+	for (int i = 1; i < count; i++) {
+		Worker& victim = *workers[(id + i) % count];
+		const std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) continue;
+
+		task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		--queued;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::run(Task& task) {
+	task();
+	task = nullptr;
+
+	if (pending.fetch_sub(1) == 1) {
+		const std::lock_guard<std::mutex> lock(sleepMutex);
+		idle.notify_all();
+	}
+}
+
+bool ThreadPool::runOne() {
+	if (currentPool != this) return false;
+
+	Task task;
+	if (!tryPop(currentId, task) && !trySteal(currentId, task)) return false;
+	run(task);
+	return true;
+}
+
+void ThreadPool::work(const int id) {
+	currentPool = this;
+	currentId = id;
+
+	Task task;
+	while (true) {
+		if (tryPop(id, task) || trySteal(id, task)) {
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return stopping || queued > 0; });
+		if (stopping && queued == 0) return;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Thread Pool
+
+// A fixed set of worker threads, each with its own deque of tasks
+// Workers take their own newest task first, and when they run dry they steal the oldest task from another worker
+class ThreadPool {
+public:
+	typedef std::function<void()> Task;
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+
+	// Tasks submitted but not finished
+	std::atomic<int64_t> pending;
+	// Tasks sitting in a deque, waiting for a worker
+	std::atomic<int64_t> queued;
+	// Where the next task from outside the pool goes
+	std::atomic<unsigned> nextWorker;
+	bool stopping;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+
+	void work(const int id);
+	bool tryPop(const int id, Task& task);
+	bool trySteal(const int id, Task& task);
+	void run(Task& task);
+
+public:
+	// Starts a pool with the given number of threads, or one per core if threadCount <= 0
+	explicit ThreadPool(const int threadCount);
+	// Finishes every submitted task, then stops the threads
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queues a task, which must not throw. From inside a task it goes on that worker's own deque, otherwise they are dealt out in turn
+	void submit(Task task);
+	// Blocks until every submitted task (including ones submitted by tasks) has finished. Not for use inside a task
+	void wait();
+	// Runs one waiting task on the calling worker, so a task that has to wait on others can help instead of blocking its worker
+	// Returns false if there was nothing to run, or the caller isn't one of this pool's workers
+	bool runOne();
+
+	[[nodiscard]] int size() const noexcept;
+	// The index of the worker running the calling thread, or -1 if it isn't one of this pool's workers
+	[[nodiscard]] int currentWorker() const noexcept;
+};
\ No newline at end of file
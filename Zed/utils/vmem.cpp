@@ -0,0 +1,392 @@
+#include "vmem.h"
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Virtual Memory Utils
+
+size_t vmem::pageSize() noexcept {
+#ifdef _WIN32
+	static const size_t size = [] {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return static_cast<size_t>(info.dwPageSize);
+	}();
+#else
+	static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	return size;
+}
+
+size_t vmem::roundUp(const size_t size) noexcept {
+	const size_t page = pageSize();
+	return (size + page - 1) / page * page;
+}
+
+char* vmem::reserve(const size_t size) noexcept {
+#ifdef _WIN32
+	return static_cast<char*>(VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+#else
+	void* const addr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return addr == MAP_FAILED ? nullptr : static_cast<char*>(addr);
+#endif
+}
+
+char* vmem::reserveAt(char* const addr, const size_t size) noexcept {
+#ifdef _WIN32
+	return static_cast<char*>(VirtualAlloc(addr, size, MEM_RESERVE, PAGE_NOACCESS));
+#else
+#ifdef MAP_FIXED_NOREPLACE
+	constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE;
+#else
+	constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#endif
+	void* const got = mmap(addr, size, PROT_NONE, flags, -1, 0);
+	if (got == MAP_FAILED) return nullptr;
+
+	// Without MAP_FIXED_NOREPLACE (or on kernels that ignore it) the address is only a hint
+	if (got != addr) {
+		munmap(got, size);
+		return nullptr;
+	}
+	return addr;
+#endif
+}
+
+bool vmem::commit(char* const addr, const size_t size) noexcept {
+#ifdef _WIN32
+	return VirtualAlloc(addr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	return mprotect(addr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+bool vmem::protect(char* const addr, const size_t size, const bool writable) noexcept {
+#ifdef _WIN32
+	DWORD old;
+	return VirtualProtect(addr, size, writable ? PAGE_READWRITE : PAGE_READONLY, &old) != 0;
+#else
+	return mprotect(addr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ) == 0;
+#endif
+}
+
+void vmem::decommit(char* const addr, const size_t size) noexcept {
+#ifdef _WIN32
+	VirtualFree(addr, size, MEM_DECOMMIT);
+#else
+	mmap(addr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+}
+
+void vmem::release(char* const addr, const size_t size) noexcept {
+	if (!addr) return;
+#ifdef _WIN32
+	VirtualFree(addr, 0, MEM_RELEASE);
+#else
+	munmap(addr, size);
+#endif
+}
+
+char* vmem::mapFile(const char* const path, size_t& size, char* const addr) noexcept {
+#ifdef _WIN32
+	const HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length)) {
+		CloseHandle(file);
+		return nullptr;
+	}
+	if (static_cast<size_t>(length.QuadPart) > size) size = static_cast<size_t>(length.QuadPart);
+
+	// Making a mapping bigger than the file grows the file
+	const uint64_t want = size;
+	const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(want >> 32), static_cast<DWORD>(want), nullptr);
+	CloseHandle(file);
+	if (!mapping) return nullptr;
+
+	void* view = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, addr);
+	if (!view && addr) view = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, nullptr);
+	// The view keeps the mapping alive
+	CloseHandle(mapping);
+	return static_cast<char*>(view);
+#else
+	const int file = open(path, O_RDWR | O_CREAT, 0644);
+	if (file < 0) return nullptr;
+
+	struct stat info {};
+	if (fstat(file, &info) != 0) {
+		close(file);
+		return nullptr;
+	}
+	if (static_cast<size_t>(info.st_size) < size) {
+		if (ftruncate(file, static_cast<off_t>(size)) != 0) {
+			close(file);
+			return nullptr;
+		}
+	} else {
+		size = static_cast<size_t>(info.st_size);
+	}
+
+	void* view = MAP_FAILED;
+	if (addr) {
+	#ifdef MAP_FIXED_NOREPLACE
+		view = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, file, 0);
+	#else
+		view = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	#endif
+	}
+	if (view == MAP_FAILED) view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	// The mapping keeps the file open
+	close(file);
+	return view == MAP_FAILED ? nullptr : static_cast<char*>(view);
+#endif
+}
+
+void vmem::flushFile(char* const addr, const size_t size) noexcept {
+#ifdef _WIN32
+	FlushViewOfFile(addr, size);
+#else
+	msync(addr, size, MS_SYNC);
+#endif
+}
+
+void vmem::unmapFile(char* const addr, const size_t size) noexcept {
+	if (!addr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(addr);
+#else
+	munmap(addr, size);
+#endif
+}
+
+vmem::Shared vmem::createShared(const size_t size) noexcept {
+#ifdef _WIN32
+	const uint64_t want = size;
+	const HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(want >> 32), static_cast<DWORD>(want), nullptr);
+	return mapping ? reinterpret_cast<Shared>(mapping) : NO_SHARED;
+#else
+#ifdef MFD_CLOEXEC
+	const int memory = memfd_create("zed", MFD_CLOEXEC);
+#else
+	// Unlinked straight away, so it's only reachable through the descriptor
+	char name[] = "/tmp/zed-XXXXXX";
+	const int memory = mkstemp(name);
+	if (memory >= 0) unlink(name);
+#endif
+	if (memory < 0) return NO_SHARED;
+	if (ftruncate(memory, static_cast<off_t>(size)) != 0) {
+		close(memory);
+		return NO_SHARED;
+	}
+	return memory;
+#endif
+}
+
+void vmem::closeShared(const Shared shared) noexcept {
+	if (shared == NO_SHARED) return;
+#ifdef _WIN32
+	CloseHandle(reinterpret_cast<HANDLE>(shared));
+#else
+	close(static_cast<int>(shared));
+#endif
+}
+
+char* vmem::mapShared(const Shared shared, const size_t size) noexcept {
+#ifdef _WIN32
+	return static_cast<char*>(MapViewOfFile(reinterpret_cast<HANDLE>(shared), FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+	void* const view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, static_cast<int>(shared), 0);
+	return view == MAP_FAILED ? nullptr : static_cast<char*>(view);
+#endif
+}
+
+char* vmem::mapCopy(const Shared shared, const size_t size, char* const addr) noexcept {
+#ifdef _WIN32
+	return static_cast<char*>(MapViewOfFileEx(reinterpret_cast<HANDLE>(shared), FILE_MAP_COPY, 0, 0, size, addr));
+#else
+	int flags = MAP_PRIVATE;
+#ifdef MAP_FIXED_NOREPLACE
+	if (addr) flags |= MAP_FIXED_NOREPLACE;
+#endif
+	void* const view = mmap(addr, size, PROT_READ | PROT_WRITE, flags, static_cast<int>(shared), 0);
+	if (view == MAP_FAILED) return nullptr;
+
+	// Without MAP_FIXED_NOREPLACE the address is only a hint
+	if (addr && view != addr) {
+		munmap(view, size);
+		return nullptr;
+	}
+	return static_cast<char*>(view);
+#endif
+}
+
+namespace {
+#ifdef _WIN32
+	std::string namedPath(const char* const name) {
+		return std::string("Local\\") + name;
+	}
+#else
+	std::string namedPath(const char* const name) {
+		return std::string("/") + name;
+	}
+#endif
+}
+
+char* vmem::createNamed(const char* const name, const size_t size) noexcept {
+#ifdef _WIN32
+	const uint64_t want = size;
+	const HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(want >> 32), static_cast<DWORD>(want), namedPath(name).c_str());
+	if (!mapping) return nullptr;
+	// The view keeps the mapping, and its name, alive
+	void* const view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	CloseHandle(mapping);
+	return static_cast<char*>(view);
+#else
+	const int memory = shm_open(namedPath(name).c_str(), O_RDWR | O_CREAT, 0644);
+	if (memory < 0) return nullptr;
+	// Emptied first, in case it was left by a process that had the same id
+	if (ftruncate(memory, 0) != 0 || ftruncate(memory, static_cast<off_t>(size)) != 0) {
+		close(memory);
+		return nullptr;
+	}
+	void* const view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+	close(memory);
+	return view == MAP_FAILED ? nullptr : static_cast<char*>(view);
+#endif
+}
+
+char* vmem::openNamed(const char* const name, const size_t size) noexcept {
+#ifdef _WIN32
+	const HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, namedPath(name).c_str());
+	if (!mapping) return nullptr;
+	void* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+	CloseHandle(mapping);
+	return static_cast<char*>(view);
+#else
+	const int memory = shm_open(namedPath(name).c_str(), O_RDONLY, 0);
+	if (memory < 0) return nullptr;
+	struct stat info {};
+	if (fstat(memory, &info) != 0 || static_cast<size_t>(info.st_size) < size) {
+		close(memory);
+		return nullptr;
+	}
+	void* const view = mmap(nullptr, size, PROT_READ, MAP_SHARED, memory, 0);
+	close(memory);
+	return view == MAP_FAILED ? nullptr : static_cast<char*>(view);
+#endif
+}
+
+void vmem::removeNamed(const char* const name) noexcept {
+#ifndef _WIN32
+	shm_unlink(namedPath(name).c_str());
+#endif
+}
+
+vmem::File vmem::openFile(const char* const path, const bool writable) noexcept {
+#ifdef _WIN32
+	const HANDLE file = CreateFileA(path, GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	return file == INVALID_HANDLE_VALUE ? NO_FILE : reinterpret_cast<File>(file);
+#else
+	const int file = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+	return file < 0 ? NO_FILE : file;
+#endif
+}
+
+void vmem::closeFile(const File file) noexcept {
+	if (file == NO_FILE) return;
+#ifdef _WIN32
+	CloseHandle(reinterpret_cast<HANDLE>(file));
+#else
+	close(static_cast<int>(file));
+#endif
+}
+
+uint64_t vmem::fileSize(const File file) noexcept {
+#ifdef _WIN32
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(reinterpret_cast<HANDLE>(file), &length)) return UINT64_MAX;
+	return static_cast<uint64_t>(length.QuadPart);
+#else
+	struct stat info {};
+	if (fstat(static_cast<int>(file), &info) != 0) return UINT64_MAX;
+	return static_cast<uint64_t>(info.st_size);
+#endif
+}
+
+char* vmem::mapView(const File file, const uint64_t offset, const size_t size, const bool writable) noexcept {
+#ifdef _WIN32
+	const HANDLE mapping = CreateFileMappingA(reinterpret_cast<HANDLE>(file), nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) return nullptr;
+	void* const view = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), size);
+	// The view keeps the mapping alive
+	CloseHandle(mapping);
+	return static_cast<char*>(view);
+#else
+	const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+	void* const view = mmap(nullptr, size, prot, MAP_SHARED, static_cast<int>(file), static_cast<off_t>(offset));
+	return view == MAP_FAILED ? nullptr : static_cast<char*>(view);
+#endif
+}
+
+int64_t vmem::readFile(const File file, const uint64_t offset, char* const buffer, const size_t size) noexcept {
+	size_t done = 0;
+	while (done < size) {
+	#ifdef _WIN32
+		OVERLAPPED at{};
+		at.Offset = static_cast<DWORD>(offset + done);
+		at.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+		DWORD moved = 0;
+		const DWORD want = static_cast<DWORD>(std::min<size_t>(size - done, 0x40000000));
+		if (!ReadFile(reinterpret_cast<HANDLE>(file), buffer + done, want, &moved, &at)) {
+			if (GetLastError() == ERROR_HANDLE_EOF) break;
+			return -1;
+		}
+	#else
+		const ssize_t moved = pread(static_cast<int>(file), buffer + done, size - done, static_cast<off_t>(offset + done));
+		if (moved < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+	#endif
+		if (moved == 0) break;
+		done += static_cast<size_t>(moved);
+	}
+	return static_cast<int64_t>(done);
+}
+
+int64_t vmem::writeFile(const File file, const uint64_t offset, const char* const buffer, const size_t size) noexcept {
+	size_t done = 0;
+	while (done < size) {
+	#ifdef _WIN32
+		OVERLAPPED at{};
+		at.Offset = static_cast<DWORD>(offset + done);
+		at.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+		DWORD moved = 0;
+		const DWORD want = static_cast<DWORD>(std::min<size_t>(size - done, 0x40000000));
+		if (!WriteFile(reinterpret_cast<HANDLE>(file), buffer + done, want, &moved, &at)) return -1;
+	#else
+		const ssize_t moved = pwrite(static_cast<int>(file), buffer + done, size - done, static_cast<off_t>(offset + done));
+		if (moved < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+	#endif
+		if (moved == 0) return -1;
+		done += static_cast<size_t>(moved);
+	}
+	return static_cast<int64_t>(done);
+}
\ No newline at end of file
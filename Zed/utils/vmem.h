@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Virtual Memory Utils
+
+// Thin wrappers over the platform's page-level memory calls (VirtualAlloc or mmap)
+namespace vmem {
+	// The size of one page of virtual memory
+	[[nodiscard]] size_t pageSize() noexcept;
+	// Rounds a size up to a whole number of pages
+	[[nodiscard]] size_t roundUp(const size_t size) noexcept;
+
+	// Reserves address space without backing it, or returns nullptr. Touching it faults until it is committed
+	[[nodiscard]] char* reserve(const size_t size) noexcept;
+	// Reserves address space starting exactly at addr, or returns nullptr if any of it is already in use
+	[[nodiscard]] char* reserveAt(char* const addr, const size_t size) noexcept;
+	// Backs reserved pages with readable and writable memory
+	bool commit(char* const addr, const size_t size) noexcept;
+	// Makes committed pages read-only, or readable and writable again
+	bool protect(char* const addr, const size_t size, const bool writable) noexcept;
+	// Drops the memory behind committed pages, leaving them reserved. They read as zero once committed again
+	void decommit(char* const addr, const size_t size) noexcept;
+	// Returns reserved address space to the system
+	void release(char* const addr, const size_t size) noexcept;
+
+	// Maps a whole file, shared so that writes go back to it. It is created, or grown to size, if it is smaller
+	// size is set to the size of the mapping. Tries to put it at addr, if that isn't null, and otherwise anywhere
+	[[nodiscard]] char* mapFile(const char* const path, size_t& size, char* const addr) noexcept;
+	// Writes a mapping's changes back to its file
+	void flushFile(char* const addr, const size_t size) noexcept;
+	// Unmaps anything from mapFile, mapShared or mapCopy
+	void unmapFile(char* const addr, const size_t size) noexcept;
+
+	// A block of memory that isn't in the address space itself, but can be mapped into it any number of times
+	// A file descriptor or a HANDLE, depending on the platform
+	typedef intptr_t Shared;
+	constexpr Shared NO_SHARED = -1;
+
+	// Makes a block of shared memory, or returns NO_SHARED
+	[[nodiscard]] Shared createShared(const size_t size) noexcept;
+	void closeShared(const Shared shared) noexcept;
+	// Maps shared memory so that writes go back to it, for filling it in
+	[[nodiscard]] char* mapShared(const Shared shared, const size_t size) noexcept;
+	// Maps shared memory copy-on-write, so that the mapping shares every page it doesn't write to with every other mapping
+	// Goes exactly at addr, if that isn't null. Returns nullptr on failure
+	[[nodiscard]] char* mapCopy(const Shared shared, const size_t size, char* const addr) noexcept;
+
+	// Shared memory that other processes can find by name. Unmapped by unmapFile
+	// Makes it, or takes over a stale one with the same name, mapped so that writes go to it. Returns nullptr on failure
+	[[nodiscard]] char* createNamed(const char* const name, const size_t size) noexcept;
+	// Maps one that another process made, read-only, or returns nullptr if there isn't one
+	[[nodiscard]] char* openNamed(const char* const name, const size_t size) noexcept;
+	// Takes the name away, so nothing else can open it. On Windows it goes by itself once the last mapping is gone
+	void removeNamed(const char* const name) noexcept;
+
+	// A file opened for mapping pieces of it. A file descriptor or a HANDLE, depending on the platform
+	typedef intptr_t File;
+	constexpr File NO_FILE = -1;
+
+	// Opens a file that already exists, or returns NO_FILE
+	[[nodiscard]] File openFile(const char* const path, const bool writable) noexcept;
+	void closeFile(const File file) noexcept;
+	// Returns UINT64_MAX on failure
+	[[nodiscard]] uint64_t fileSize(const File file) noexcept;
+	// Maps size bytes of a file from offset, which must be a multiple of 64KB. Writes go back to the file if writable is set,
+	// and otherwise the view is read-only. Returns nullptr on failure. Unmapped by unmapFile
+	[[nodiscard]] char* mapView(const File file, const uint64_t offset, const size_t size, const bool writable) noexcept;
+	// Read or write at an offset without using the file's position, so any number of them can be under way at once
+	// Return how many bytes were moved, which is less than size only at the end of the file, or -1 on failure
+	[[nodiscard]] int64_t readFile(const File file, const uint64_t offset, char* const buffer, const size_t size) noexcept;
+	[[nodiscard]] int64_t writeFile(const File file, const uint64_t offset, const char* const buffer, const size_t size) noexcept;
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "batch.h"
+#include "vm.h"
+#include "../utils/io_utils.h"
+#include "../utils/thread_pool.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Batch Settings
+
+executor::BatchSettings::BatchSettings() noexcept : threads(0), reportPath(nullptr) {}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Batch Functions
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	// One line of the manifest, and what happened when it ran
+	struct Job {
+		int line;
+		std::string program;
+		std::string input;
+		std::string output;
+		std::shared_ptr<const bytecode::Image> image;
+
+		int code;
+		double ms;
+		std::string error;
+	};
+
+	// Runs a job on the calling worker's VM, with its input and output kept in its own buffers
+	void runJob(Job& job, std::unique_ptr<executor::VM>& vm, const executor::ExecutorSettings& settings) noexcept {
+		const Clock::time_point start = Clock::now();
+		std::stringstream in;
+		std::stringstream out;
+
+		try {
+			if (!job.image) {
+				throw std::runtime_error("Could not open file \"" + job.program + "\"");
+			}
+
+			if (job.input != "-") {
+				std::ifstream file(job.input, std::ios::in | std::ios::binary);
+				if (!file.is_open()) {
+					throw std::runtime_error("Could not open file \"" + job.input + "\"");
+				}
+				in.str(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+			}
+
+			if (!vm) vm = std::make_unique<executor::VM>(settings);
+			vm->setStreams(in, out);
+			vm->load(job.image);
+			vm->run();
+			job.code = 0;
+		} catch (const executor::ExecutorException& e) {
+			job.code = 1;
+			job.error = "Error during execution at BYTE" + std::to_string(e.getLoc()) + " : " + e.what();
+		} catch (const std::exception& e) {
+			job.code = 1;
+			job.error = e.what();
+		}
+
+		// Whatever was printed before an error is still worth keeping
+		if (job.output != "-") {
+			std::ofstream file(job.output, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (file.is_open()) {
+				file << out.str();
+			} else if (!job.code) {
+				job.code = 1;
+				job.error = "Could not open file \"" + job.output + "\"";
+			}
+		}
+
+		job.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+int executor::batch(const char* const manifestPath, const BatchSettings& settings) {
+	using namespace executor;
+	using std::cout;
+
+	cout << IO_MAIN "Attempting to run batch \"" << manifestPath << "\"\n" IO_NORM;
+
+	std::fstream manifest;
+	manifest.open(manifestPath, std::ios::in);
+	if (!manifest.is_open()) {
+		cout << IO_ERR "Could not open file \"" << manifestPath << "\"" IO_NORM IO_END;
+		return 1;
+	}
+
+	try {
+		const int out = executor::batch_(manifest, settings, cout);
+		cout << IO_MAIN "Batch finished with code: " << out << IO_NORM IO_END;
+		return out;
+	} catch (const ExecutorException& e) {
+		cout << IO_ERR "Error in batch manifest at LINE " << e.getLoc() << " : " << e.what() << IO_NORM IO_END;
+	} catch (const std::exception& e) {
+		cout << IO_ERR "An unknown error occurred while running the batch. This error is most likely an issue with the c++ executor code, not your code. Sorry. The provided error message is as follows:\n" << e.what() << IO_NORM IO_END;
+	}
+
+	return 1;
+}
+
+int executor::batch_(std::istream& manifest, const BatchSettings& settings, std::ostream& stream) {
+	const bool isDebug = settings.exec.flags.hasFlags(Flags::FLAG_DEBUG);
+
+	// Read the manifest
+	std::vector<Job> jobs;
+	std::string line;
+	int lineNum = 0;
+	while (std::getline(manifest, line)) {
+		lineNum++;
+
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == ';') continue;
+
+		Job job{};
+		job.line = lineNum;
+		std::istringstream fields(line);
+		if (!(fields >> std::quoted(job.program) >> std::quoted(job.input) >> std::quoted(job.output))) {
+			throw ExecutorException(ExecutorException::ErrorType::BAD_MANIFEST, lineNum, "expected a program, an input and an output");
+		}
+		jobs.push_back(std::move(job));
+	}
+
+	// Load each distinct program once, to be shared by every job that runs it
+	std::unordered_map<std::string, std::shared_ptr<const bytecode::Image>> images;
+	for (Job& job : jobs) {
+		const auto [it, added] = images.try_emplace(job.program);
+		if (added) {
+			std::fstream file;
+			file.open(job.program, std::ios::in | std::ios::binary);
+			if (file.is_open()) {
+				it->second = std::make_shared<const bytecode::Image>(file);
+			}
+		}
+		job.image = it->second;
+	}
+
+	if (isDebug) {
+		stream << IO_DEBUG "Loaded " << images.size() << " programs for " << jobs.size() << " jobs" IO_NORM "\n";
+	}
+
+	// Run everything. Each worker keeps one VM and reuses it for every job it picks up
+	const Clock::time_point start = Clock::now();
+	int threads = 0;
+	{
+		ThreadPool pool(settings.threads);
+		threads = pool.size();
+
+		std::vector<std::unique_ptr<VM>> vms(static_cast<size_t>(threads));
+		for (Job& job : jobs) {
+			pool.submit([&job, &vms, &pool, &settings] {
+				runJob(job, vms[pool.currentWorker()], settings.exec);
+			});
+		}
+		pool.wait();
+	}
+	const double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	// Report
+	int failed = 0;
+	for (const Job& job : jobs) {
+		if (job.code) {
+			failed++;
+			stream << IO_WARN "Job on LINE " << job.line << " (" << job.program << ") finished with code " << job.code;
+			if (!job.error.empty()) stream << " : " << job.error;
+			stream << IO_NORM "\n";
+		} else if (isDebug) {
+			stream << IO_DEBUG "Job on LINE " << job.line << " (" << job.program << ") took " << job.ms << " ms" IO_NORM "\n";
+		}
+	}
+
+	stream << IO_INFO "Ran " << jobs.size() << " jobs (" << failed << " failed) on " << threads << " threads in " << totalMs << " ms" IO_NORM "\n";
+
+	if (settings.reportPath) {
+		std::ofstream report(settings.reportPath, std::ios::out | std::ios::trunc);
+		if (!report.is_open()) {
+			stream << IO_WARN "Could not open file \"" << settings.reportPath << "\"" IO_NORM "\n";
+		} else {
+			report << "line\tprogram\tinput\toutput\tcode\tms\terror\n";
+			for (const Job& job : jobs) {
+				report << job.line << '\t' << job.program << '\t' << job.input << '\t' << job.output << '\t'
+					<< job.code << '\t' << job.ms << '\t' << job.error << '\n';
+			}
+		}
+	}
+
+	return failed ? 1 : 0;
+}
\ No newline at end of file
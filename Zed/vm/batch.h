@@ -0,0 +1,29 @@
+#pragma once
+#include "executor.h"
+#include <iostream>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Batch Settings
+
+	// Holds settings info about running a batch of executables
+	struct BatchSettings {
+		// Settings for each job
+		ExecutorSettings exec;
+		// Worker threads, or 0 for one per core
+		int threads;
+		// Where to write every job's exit code and timing, or null for nowhere
+		const char* reportPath;
+
+		BatchSettings() noexcept;
+	};
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Batch Functions
+
+	// Runs every job in a manifest file across a pool of threads
+	// Each line of the manifest is a job: the .eze file, a file to use as its input, and a file to write its output to.
+	// Paths can be quoted, "-" means no input or no output, and lines starting with ';' are comments
+	int batch(const char* const manifestPath, const BatchSettings& settings);
+	int batch_(std::istream& manifest, const BatchSettings& settings, std::ostream& stream);
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "channel.h"
+#include <chrono>
+#include <thread>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Channels
+
+namespace {
+	// Spins for a while, then gives up the core, then sleeps, so a stalled pipeline doesn't burn every core
+	void backoff(const int attempt) noexcept {
+		if (attempt < 64) return;
+		if (attempt < 128) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	size_t roundCapacity(const size_t capacity) noexcept {
+		size_t out = 2;
+		while (out < capacity) out <<= 1;
+		return out;
+	}
+}
+
+executor::Channel::Channel(const size_t capacity) : cells(std::make_unique<Cell[]>(roundCapacity(capacity))),
+	mask(roundCapacity(capacity) - 1), sendPos(0), receivePos(0), senders(0), receivers(0), broken(false) {
+	for (size_t i = 0; i <= mask; i++) {
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+bool executor::Channel::trySend(const bytecode::types::word_t value) noexcept {
+	size_t pos = sendPos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (true) {
+		cell = &cells[pos & mask];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+		if (diff == 0) {
+			// The cell is free for this lap, if nobody else claims it first
+			if (sendPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		} else if (diff < 0) {
+			// Still holding a value from the last lap, so the channel is full
+			return false;
+		} else {
+			pos = sendPos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->value = value;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool executor::Channel::tryReceive(bytecode::types::word_t& value) noexcept {
+	size_t pos = receivePos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (true) {
+		cell = &cells[pos & mask];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+		if (diff == 0) {
+			if (receivePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		} else if (diff < 0) {
+			// Nothing sent into it yet, so the channel is empty
+			return false;
+		} else {
+			pos = receivePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	value = cell->value;
+	// Free for the sender one lap ahead
+	cell->sequence.store(pos + mask + 1, std::memory_order_release);
+	return true;
+}
+
+executor::Channel::Status executor::Channel::send(const bytecode::types::word_t value) noexcept {
+	for (int attempt = 0; ; attempt++) {
+		if (trySend(value)) return Status::OK;
+		if (broken.load(std::memory_order_relaxed)) return Status::BROKEN;
+		if (receivers.load(std::memory_order_acquire) == 0) return Status::CLOSED;
+		backoff(attempt);
+	}
+}
+
+executor::Channel::Status executor::Channel::receive(bytecode::types::word_t& value) noexcept {
+	for (int attempt = 0; ; attempt++) {
+		if (tryReceive(value)) return Status::OK;
+		if (broken.load(std::memory_order_relaxed)) return Status::BROKEN;
+		if (senders.load(std::memory_order_acquire) == 0) {
+			// Every send happened before the last sender left, so one more look is enough
+			return tryReceive(value) ? Status::OK : Status::CLOSED;
+		}
+		backoff(attempt);
+	}
+}
+
+void executor::Channel::addSender() noexcept {
+	senders.fetch_add(1, std::memory_order_relaxed);
+}
+
+void executor::Channel::removeSender() noexcept {
+	senders.fetch_sub(1, std::memory_order_release);
+}
+
+void executor::Channel::addReceiver() noexcept {
+	receivers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void executor::Channel::removeReceiver() noexcept {
+	receivers.fetch_sub(1, std::memory_order_release);
+}
+
+void executor::Channel::break_() noexcept {
+	broken.store(true, std::memory_order_relaxed);
+}
+
+size_t executor::Channel::capacity() const noexcept {
+	return mask + 1;
+}
\ No newline at end of file
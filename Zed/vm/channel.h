@@ -0,0 +1,64 @@
+#pragma once
+#include "../utils/bytecode.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Channels
+
+	// A bounded, lock-free, multi-producer multi-consumer queue of words, connecting isolates (separate VMs)
+	// Each cell carries a sequence number saying whose turn it is, so senders and receivers only ever contend on a single CAS
+	// The channel closes once every sender has left, and receivers then drain what's left before being told so
+	class Channel {
+	public:
+		enum class Status {
+			OK,
+			CLOSED,	// Nobody left on the other end
+			BROKEN	// Something on the other end failed
+		};
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			bytecode::types::word_t value;
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		const size_t mask;
+
+		// Kept on separate cache lines, since senders only touch one and receivers the other
+		alignas(64) std::atomic<size_t> sendPos;
+		alignas(64) std::atomic<size_t> receivePos;
+
+		alignas(64) std::atomic<int> senders;
+		std::atomic<int> receivers;
+		std::atomic<bool> broken;
+
+	public:
+		// The capacity is rounded up to a power of two
+		explicit Channel(const size_t capacity);
+
+		Channel(const Channel&) = delete;
+		Channel& operator=(const Channel&) = delete;
+
+		// Never block
+		[[nodiscard]] bool trySend(const bytecode::types::word_t value) noexcept;
+		[[nodiscard]] bool tryReceive(bytecode::types::word_t& value) noexcept;
+
+		// Block until there's room, or a value, spinning and then backing off
+		Status send(const bytecode::types::word_t value) noexcept;
+		Status receive(bytecode::types::word_t& value) noexcept;
+
+		// Who is on each end. Set up before anything runs, and left as each isolate finishes
+		void addSender() noexcept;
+		void removeSender() noexcept;
+		void addReceiver() noexcept;
+		void removeReceiver() noexcept;
+		// Wakes everything blocked on the channel with BROKEN, for when an isolate fails
+		void break_() noexcept;
+
+		[[nodiscard]] size_t capacity() const noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "coverage.h"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Coverage
+
+namespace {
+	using bytecode::types::opcode_t;
+	using bytecode::types::word_t;
+
+	// Where in an instruction the address of code it jumps to or starts is, or 0 if it doesn't have one
+	int codeArgument(const opcode_t opcode) noexcept {
+		using namespace bytecode::Opcode;
+
+		switch (opcode) {
+			case JMP:
+			case JMP_Z:
+			case JMP_NZ:
+			case PARFOR:
+				return sizeof(opcode_t);
+			case SPAWN:
+			case TASK_SPAWN:
+				return sizeof(opcode_t) + sizeof(bytecode::types::reg_t);
+			default:
+				return 0;
+		}
+	}
+
+	bool isConditional(const opcode_t opcode) noexcept {
+		using namespace bytecode::Opcode;
+		return opcode == JMP_Z || opcode == JMP_NZ || opcode == R_JMP_Z || opcode == R_JMP_NZ;
+	}
+
+	// Whether control never carries on to the next instruction
+	bool endsFlow(const opcode_t opcode) noexcept {
+		using namespace bytecode::Opcode;
+		return opcode == JMP || opcode == R_JMP || opcode == HALT || opcode == SNAPSHOT;
+	}
+
+	constexpr const char* COVERAGE_MAGIC = "zedcov";
+	constexpr int COVERAGE_VERSION = 1;
+}
+
+executor::Coverage::Coverage(const bytecode::Program& program, const CoverageCount* const counts) : programSize(program.size()) {
+	const char* const code = program.begin();
+
+	// What's known about each offset so far
+	enum : char { UNKNOWN, START, INSIDE };
+	std::vector<char> kind(programSize, UNKNOWN);
+	std::vector<bool> leader(programSize + 1, false);
+
+	std::vector<word_t> work;
+	const auto reach = [&](const word_t offset) {
+		if (offset < 0 || offset >= programSize) return;
+		leader[offset] = true;
+		work.push_back(offset);
+	};
+	word_t entry;
+	std::memcpy(&entry, code + bytecode::FIRST_INSTR_ADDR_LOCATION, sizeof(entry));
+	reach(entry);
+	for (word_t offset = 0; offset < programSize; offset++) {
+		if (counts[offset].entries) reach(offset);
+	}
+
+	while (!work.empty()) {
+		word_t pos = work.back();
+		work.pop_back();
+
+		while (pos >= 0 && pos < programSize && kind[pos] == UNKNOWN) {
+			const auto opcode = static_cast<opcode_t>(code[pos]);
+			const int size = bytecode::instructionSize(opcode);
+			if (!size || pos + size > programSize) break;
+			// Decoding from the middle of an instruction found some other way
+			bool overlaps = false;
+			for (int i = 1; i < size; i++) overlaps |= kind[pos + i] != UNKNOWN;
+			if (overlaps) break;
+
+			kind[pos] = START;
+			std::fill(kind.begin() + pos + 1, kind.begin() + pos + size, INSIDE);
+
+			if (const int arg = codeArgument(opcode)) {
+				word_t target;
+				std::memcpy(&target, code + pos + arg, sizeof(target));
+				reach(target);
+			}
+			if (isConditional(opcode) || endsFlow(opcode)) leader[pos + size] = true;
+			pos += size;
+		}
+	}
+
+	// Cut the decoded instructions into blocks, remembering how each one ends
+	std::vector<opcode_t> lastOpcode;
+	for (word_t pos = 0; pos < programSize; pos++) {
+		if (kind[pos] != START) continue;
+
+		const auto opcode = static_cast<opcode_t>(code[pos]);
+		if (leader[pos] || blocks.empty() || blocks.back().offset + blocks.back().size != pos) {
+			blocks.push_back(Block{ pos, 0, 0 });
+			lastOpcode.push_back(opcode);
+		}
+		blocks.back().size += bytecode::instructionSize(opcode);
+		lastOpcode.back() = opcode;
+
+		if (isConditional(opcode)) branches.push_back(Branch{ pos, counts[pos].taken, counts[pos].notTaken });
+	}
+
+	// A block runs whenever control arrives at it, and whenever the block before it runs off its end into it
+	// Conditional jumps that aren't taken count as arriving, so only blocks without a jump at the end fall through
+	for (size_t i = 0; i < blocks.size(); i++) {
+		blocks[i].count = counts[blocks[i].offset].entries;
+		if (i > 0 && blocks[i - 1].offset + blocks[i - 1].size == blocks[i].offset &&
+			!isConditional(lastOpcode[i - 1]) && !endsFlow(lastOpcode[i - 1])) {
+			blocks[i].count += blocks[i - 1].count;
+		}
+	}
+}
+
+executor::Coverage::Coverage(std::istream& in) : programSize(0) {
+	std::string magic;
+	int version = 0;
+	size_t blockCount = 0, branchCount = 0;
+	if (!(in >> magic >> version >> programSize >> blockCount >> branchCount) || magic != COVERAGE_MAGIC || version != COVERAGE_VERSION) {
+		throw std::runtime_error("Not a coverage file");
+	}
+
+	std::string tag;
+	for (size_t i = 0; i < blockCount; i++) {
+		Block block{};
+		if (!(in >> tag >> block.offset >> block.size >> block.count) || tag != "block") throw std::runtime_error("Invalid coverage block");
+		blocks.push_back(block);
+	}
+	for (size_t i = 0; i < branchCount; i++) {
+		Branch branch{};
+		if (!(in >> tag >> branch.offset >> branch.taken >> branch.notTaken) || tag != "branch") throw std::runtime_error("Invalid coverage branch");
+		branches.push_back(branch);
+	}
+}
+
+void executor::Coverage::write(std::ostream& out) const {
+	out << COVERAGE_MAGIC << " " << COVERAGE_VERSION << " " << programSize << " " << blocks.size() << " " << branches.size() << "\n";
+	for (const Block& block : blocks) {
+		out << "block " << block.offset << " " << block.size << " " << block.count << "\n";
+	}
+	for (const Branch& branch : branches) {
+		out << "branch " << branch.offset << " " << branch.taken << " " << branch.notTaken << "\n";
+	}
+}
+
+executor::CoverageCount* executor::CoverageCounter::newCounts(const bytecode::Program& program) {
+	const std::lock_guard<std::mutex> lock(mutex);
+	counts.push_back(std::make_unique<CoverageCount[]>(program.size()));
+	return counts.back().get();
+}
+
+void executor::CoverageCounter::clear() noexcept {
+	const std::lock_guard<std::mutex> lock(mutex);
+	counts.clear();
+}
+
+executor::Coverage executor::CoverageCounter::total(const bytecode::Program& program) {
+	const int size = program.size();
+	std::vector<CoverageCount> total(size);
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& thread : counts) {
+		for (int i = 0; i < size; i++) {
+			total[i].entries += thread[i].entries;
+			total[i].taken += thread[i].taken;
+			total[i].notTaken += thread[i].notTaken;
+		}
+	}
+	return Coverage(program, total.data());
+}
\ No newline at end of file
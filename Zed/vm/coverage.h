@@ -0,0 +1,90 @@
+#pragma once
+#include "../utils/bytecode.h"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Coverage
+
+	// What --coverage counts at one offset of a program. Only written when control moves, never per instruction
+	struct CoverageCount {
+		// Times control jumped here, fell through here from a conditional jump that wasn't taken, or started a thread here
+		uint64_t entries = 0;
+		// For a conditional jump here, the times it was and wasn't taken
+		uint64_t taken = 0;
+		uint64_t notTaken = 0;
+	};
+
+	// A run of instructions that is only ever entered at its start, and how many times it ran
+	struct Block {
+		bytecode::types::word_t offset;
+		bytecode::types::word_t size;
+		uint64_t count;
+	};
+
+	// A conditional jump, and how many times it went each way
+	struct Branch {
+		bytecode::types::word_t offset;
+		uint64_t taken;
+		uint64_t notTaken;
+	};
+
+	// The blocks and branches of one program, and how often they ran
+	struct Coverage {
+		int programSize;
+		std::vector<Block> blocks;
+		std::vector<Branch> branches;
+
+		// Finds the blocks by following jumps and falling through from the entry and from everywhere control was counted
+		// arriving, carrying on past unconditional jumps, since what follows them is usually reached through R_JMP
+		// counts has one entry per offset of the program
+		Coverage(const bytecode::Program& program, const CoverageCount* const counts);
+		// Reads what write wrote, throwing std::runtime_error if it can't
+		explicit Coverage(std::istream& in);
+
+		void write(std::ostream& out) const;
+	};
+
+	// What every thread has counted, with a coverage path. Each thread adds to counts of its own, so they never contend
+	class CoverageCounter {
+	private:
+		std::vector<std::unique_ptr<CoverageCount[]>> counts;
+		std::mutex mutex;
+
+	public:
+		CoverageCounter() = default;
+
+		CoverageCounter(const CoverageCounter&) = delete;
+		CoverageCounter& operator=(const CoverageCounter&) = delete;
+
+		// A zeroed count for every offset of a program, for a thread to add to. Kept until the next clear
+		CoverageCount* newCounts(const bytecode::Program& program);
+		// Forgets every thread's counts, which threads must no longer be using
+		void clear() noexcept;
+		// What every thread has counted in program, as blocks and branches. Only meaningful while no other threads are running
+		[[nodiscard]] Coverage total(const bytecode::Program& program);
+
+		// Control arriving at target. Does nothing without counts
+		static void enter(CoverageCount* const counts, const bytecode::Program& program, const bytecode::types::word_t target) noexcept {
+			if (counts && target >= 0 && target < program.size()) counts[target].entries++;
+		}
+
+		// The conditional jump that was just read, either jumping to target or falling through
+		static void branch(CoverageCount* const counts, const bytecode::Program& program, const bytecode::types::opcode_t opcode,
+						   const bool taken, const bytecode::types::word_t target) noexcept {
+			if (!counts) return;
+			CoverageCount& site = counts[program.offset() - bytecode::instructionSize(opcode)];
+			if (taken) {
+				site.taken++;
+				enter(counts, program, target);
+			} else {
+				site.notTaken++;
+				enter(counts, program, program.offset());
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -1,13 +1,44 @@
 #include "executor.h"
+#include "vm.h"
 #include "../utils/io_utils.h"
 #include "../utils/bytecode.h"
+#include "../utils/vmem.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <fstream>
-#include <list>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <csetjmp>
+#include <csignal>
+#include <sys/time.h>
+#endif
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Executor Settings
 
-executor::ExecutorSettings::ExecutorSettings() noexcept : stackSize(0x1000) {}
+executor::ExecutorSettings::ExecutorSettings() noexcept : stackSize(DEFAULT_STACK_SIZE), taskStackSize(DEFAULT_TASK_STACK_SIZE), heapSize(DEFAULT_HEAP_SIZE), workers(0), ioWorkers(DEFAULT_IO_WORKERS), maxInstructions(0), timeoutMs(0), snapshotPath(nullptr),
+	segmentDir(nullptr), checkpointPath(nullptr), checkpointMs(DEFAULT_CHECKPOINT_MS), sampleHz(0), samplePath(nullptr), symbolsPath(nullptr),
+	coveragePath(nullptr), metricsInterval(0), recordPath(nullptr) {}
+
+bool executor::ExecutorSettings::checksMemory() const noexcept {
+	return flags.hasFlags(Flags::FLAG_DEBUG | FLAG_CHECK_MEM);
+}
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Executor Exceptions
@@ -24,579 +55,702 @@ int executor::ExecutorException::getLoc() const noexcept {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // The Stack
 
-executor::Stack::Stack(const int size) : owner(std::make_unique<char[]>(size)) {}
+namespace {
+	// The stack whose faults are being handled on this thread
+	thread_local executor::Stack* guardedStack = nullptr;
+
+	// Every WriteWatch that is watching something, for the fault handler, which can run on any thread
+	// A watch counts as in use while the handler is looking at it, so that stopping it can wait until nothing is
+	struct WatchSlot {
+		std::atomic<executor::WriteWatch*> watch{ nullptr };
+		std::atomic<int> users{ 0 };
+	};
+	constexpr int MAX_WATCHES = 64;
+	WatchSlot watchSlots[MAX_WATCHES];
+
+	bool handleWatchFault(const void* const addr) noexcept {
+		for (WatchSlot& slot : watchSlots) {
+			slot.users++;
+			executor::WriteWatch* const watch = slot.watch.load();
+			const bool handled = watch && watch->handleFault(addr);
+			slot.users--;
+			if (handled) return true;
+		}
+		return false;
+	}
+
+#ifdef _WIN32
+	// Write watches can be hit by any code on any thread, not just guarded guest code, so they get their own handler
+	LONG CALLBACK watchHandler(EXCEPTION_POINTERS* const info) noexcept {
+		if (info->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION &&
+			handleWatchFault(reinterpret_cast<const void*>(info->ExceptionRecord->ExceptionInformation[1]))) {
+			return EXCEPTION_CONTINUE_EXECUTION;
+		}
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	LONG faultFilter(const EXCEPTION_POINTERS* const info) noexcept {
+		if (!guardedStack || info->ExceptionRecord->ExceptionCode != EXCEPTION_ACCESS_VIOLATION) {
+			return EXCEPTION_CONTINUE_SEARCH;
+		}
+
+		const void* const addr = reinterpret_cast<const void*>(info->ExceptionRecord->ExceptionInformation[1]);
+		switch (guardedStack->handleFault(addr)) {
+			case executor::Stack::Fault::COMMITTED:
+				return EXCEPTION_CONTINUE_EXECUTION;
+			case executor::Stack::Fault::GUARD:
+				return EXCEPTION_EXECUTE_HANDLER;
+			default:
+				return EXCEPTION_CONTINUE_SEARCH;
+		}
+	}
+
+	// Kept separate from Stack::guard, since __try can't share a function with objects that need unwinding
+	bool runGuarded(void (*body)(void*), void* arg) {
+		__try {
+			body(arg);
+		} __except (faultFilter(GetExceptionInformation())) {
+			return false;
+		}
+		return true;
+	}
+
+	void installFaultHandler() {
+		static std::once_flag once;
+		std::call_once(once, [] { AddVectoredExceptionHandler(1, watchHandler); });
+	}
+#else
+	// Where to jump to when the guarded stack overflows on this thread
+	thread_local sigjmp_buf* overflowJump = nullptr;
+
+	struct sigaction prevSegv {};
+	struct sigaction prevBus {};
+
+	void onFault(const int sig, siginfo_t* const info, void* const context) {
+		// Before the stack, since a watched stack page is committed, and the stack would just let the write through
+		if (handleWatchFault(info->si_addr)) return;
+
+		if (guardedStack) {
+			switch (guardedStack->handleFault(info->si_addr)) {
+				case executor::Stack::Fault::COMMITTED:
+					return;
+				case executor::Stack::Fault::GUARD:
+					siglongjmp(*overflowJump, 1);
+				default:
+					break;
+			}
+		}
+
+		// Not ours, so it goes to whatever handled it before, and this stays installed for the next fault
+		const struct sigaction& prev = sig == SIGBUS ? prevBus : prevSegv;
+		if (prev.sa_flags & SA_SIGINFO) {
+			prev.sa_sigaction(sig, info, context);
+		} else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN) {
+			prev.sa_handler(sig);
+		} else {
+			// A fault can't be ignored, so both mean the default, which kills the process once this returns
+			signal(sig, SIG_DFL);
+			raise(sig);
+		}
+	}
+
+	bool runGuarded(void (*body)(void*), void* arg) {
+		sigjmp_buf env;
+		if (sigsetjmp(env, 1)) {
+			return false;
+		}
+		overflowJump = &env;
+		body(arg);
+		return true;
+	}
+
+	void installFaultHandler() {
+		static std::once_flag once;
+		std::call_once(once, [] {
+			struct sigaction action {};
+			action.sa_sigaction = onFault;
+			action.sa_flags = SA_SIGINFO;
+			sigemptyset(&action.sa_mask);
+			sigaction(SIGSEGV, &action, &prevSegv);
+			sigaction(SIGBUS, &action, &prevBus);
+		});
+	}
+#endif
+
+	// Restores the previously guarded stack on the way out of Stack::guard, including when the body throws
+	class GuardScope {
+	private:
+		executor::Stack* const outerStack;
+	#ifndef _WIN32
+		sigjmp_buf* const outerJump;
+	#endif
+
+	public:
+		explicit GuardScope(executor::Stack* const stack) noexcept : outerStack(guardedStack)
+		#ifndef _WIN32
+			, outerJump(overflowJump)
+		#endif
+		{
+			guardedStack = stack;
+		}
+
+		~GuardScope() {
+			guardedStack = outerStack;
+		#ifndef _WIN32
+			overflowJump = outerJump;
+		#endif
+		}
+	};
+}
+
+namespace {
+	// How much of a stack is committed when it's made or reset
+	// Windows counts committed memory against a system-wide limit whether it's used or not, so it commits pages as they're
+	// first touched, with the first one up front since it's almost always used. Elsewhere the stack is reserved with
+	// MAP_NORESERVE, so mapping all of it costs nothing until it's written, and saves a fault for every page
+	size_t committedUpFront(const size_t usable) noexcept {
+	#ifdef _WIN32
+		return vmem::pageSize();
+	#else
+		return usable;
+	#endif
+	}
+}
+
+executor::Stack::Stack(const int size, char* const at) : base(nullptr), reserved(0), usable(vmem::roundUp(static_cast<size_t>(size))),
+#ifdef _WIN32
+	touched(0),
+#endif
+	taskFrames(nullptr), taskFramesSize(0) {
+	const size_t page = vmem::pageSize();
+	reserved = usable + 2 * page;
+	base = at ? vmem::reserveAt(at - page, reserved) : vmem::reserve(reserved);
+
+	if (!base || !vmem::commit(base + page, committedUpFront(usable))) {
+		vmem::release(base, reserved);
+		throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, 0, "Could not reserve the stack");
+	}
+#ifdef _WIN32
+	touched = page;
+#endif
+}
+
+executor::Stack::~Stack() {
+	vmem::release(base, reserved);
+}
 
 char* executor::Stack::begin() const noexcept {
-	return owner.get();
+	return base + vmem::pageSize();
 }
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// Executor Functions
+size_t executor::Stack::getSize() const noexcept {
+	return usable;
+}
 
-int executor::exec(const char* const path, const ExecutorSettings& settings) {
-	using namespace executor;
-	using std::cout;
-
-	cout << IO_MAIN "Attempting to execute file \"" << path << "\"\n" IO_NORM;
-
-	std::fstream file;
-	file.open(path, std::ios::in | std::ios::binary);
-
-	try {
-		const int out = executor::exec_(file, settings, std::cout, std::cin);
-		cout << IO_MAIN "Execution finished with code: " << out << IO_NORM IO_END;
-		return out;
-	} catch (const ExecutorException& e) {
-		cout << IO_ERR "Error during execution at BYTE" << e.getLoc() << " : " << e.what() << IO_NORM IO_END;
-	} catch (const std::exception& e) {
-		cout << IO_ERR "An unknown error occurred during execution. This error is most likely an issue with the c++ executor code, not your code. Sorry. The provided error message is as follows:\n" << e.what() << IO_NORM IO_END;
+size_t executor::Stack::getTouched() const noexcept {
+#ifdef _WIN32
+	return touched;
+#else
+	// Everything is mapped, so the stack reaches as far as the last page with anything in it. The rest reads as zero
+	// wherever it's put back
+	const size_t page = vmem::pageSize();
+	for (size_t end = usable; end > page; end -= page) {
+		const uint64_t* const words = reinterpret_cast<const uint64_t*>(begin() + end - page);
+		if (std::any_of(words, words + page / sizeof(uint64_t), [](const uint64_t word) { return word != 0; })) return end;
 	}
+	return page;
+#endif
+}
 
-	return 1;
+std::pair<const char*, const char*> executor::Stack::getFrames() const noexcept {
+	if (taskFrames) return { taskFrames, taskFrames + taskFramesSize };
+#ifdef _WIN32
+	return { begin(), begin() + touched };
+#else
+	return { begin(), begin() + usable };
+#endif
 }
-#define AS_WORD(x) reinterpret_cast<word_t*>(x)
-int executor::exec_(std::iostream& file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream) {
-	using namespace bytecode::types;
-	using namespace bytecode::Opcode;
-	using namespace bytecode;
-
-	// Checks that all allocated memory gets deallocated
-	const bool checkMem = settings.flags.hasFlags(Flags::FLAG_DEBUG | FLAG_CHECK_MEM);
-	std::list<char*> memAllocs;
-
-	Program program(file);
-	Stack stack(settings.stackSize);
-
-	// Registers
-	WordVal wordReg[reg::Count]{};
-	ByteVal byteReg[reg::Count]{};
-
-	// Special registers
-	wordReg[reg::BP].word = reinterpret_cast<word_t>(stack.begin());
-	wordReg[reg::RP].word = reinterpret_cast<word_t>(stack.begin());
-	wordReg[reg::PP].word = reinterpret_cast<word_t>(program.begin());
-	byteReg[reg::FZ].bool_ = 0;
-
-	program.goto_(FIRST_INSTR_ADDR_LOCATION);
-	program.goto_(*AS_WORD(program.pos()));
-
-	// Dummy values
-	opcode_t opcode = 0;
-	reg_t rid1 = 0;
-	reg_t rid2 = 0;
-	reg_t rid3 = 0;
-	word_t word = 0;
-	byte_t byte = 0;
-	int_t int_ = 0;
-	char_t char_ = 0;
-	types::float_t float_ = 0;
-	char rlchar = 0;
-	char* charptr = nullptr;
-
-#ifdef _DEBUG
-	// allow the opcode string to show up in the debugger
-	const char* strThingForDebugging;
+
+void executor::Stack::setFrames(const char* const addr, const size_t size) noexcept {
+	taskFrames = addr;
+	taskFramesSize = size;
+}
+
+bool executor::Stack::touch(const size_t size) noexcept {
+	const size_t bytes = vmem::roundUp(size);
+	if (bytes > usable || !vmem::commit(begin(), bytes)) return false;
+#ifdef _WIN32
+	touched = std::max(touched, bytes);
+#endif
+	return true;
+}
+
+void executor::Stack::reset() noexcept {
+	const size_t page = vmem::pageSize();
+	vmem::decommit(begin(), usable);
+	vmem::commit(begin(), committedUpFront(usable));
+#ifdef _WIN32
+	touched = page;
+#endif
+}
+
+void executor::Stack::addGuarded(const char* const addr, const size_t size) {
+	guarded.emplace_back(addr, size);
+}
+
+void executor::Stack::removeGuarded(const char* const addr) noexcept {
+	const auto it = std::find_if(guarded.begin(), guarded.end(), [addr](const auto& region) { return region.first == addr; });
+	if (it != guarded.end()) guarded.erase(it);
+}
+
+executor::Stack::Fault executor::Stack::handleFault(const void* const addr) noexcept {
+	const char* const ptr = static_cast<const char*>(addr);
+	if (ptr < base || ptr >= base + reserved) {
+		for (const auto& [begin, size] : guarded) {
+			if (ptr >= begin && ptr < begin + size) return Fault::GUARD;
+		}
+		return Fault::NONE;
+	}
+
+	const size_t page = vmem::pageSize();
+	if (ptr < base + page || ptr >= base + page + usable) return Fault::GUARD;
+
+	// Only Windows commits pages as they're touched. Elsewhere this is a page a WriteWatch was just letting go of
+	char* const pageStart = base + (ptr - base) / page * page;
+	if (!vmem::commit(pageStart, page)) return Fault::GUARD;
+
+#ifdef _WIN32
+	touched = std::max(touched, static_cast<size_t>(pageStart + page - begin()));
 #endif
+	return Fault::COMMITTED;
+}
 
-	while (program.inBounds()) {
-		program.read<opcode_t>(&opcode);
-	#ifdef _DEBUG
-		strThingForDebugging = opcodeStrings[opcode];
+bool executor::Stack::guard(void (*body)(void*), void* arg) {
+	installFaultHandler();
+	const GuardScope scope(this);
+	return runGuarded(body, arg);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Write Watching
+
+executor::WriteWatch::WriteWatch() noexcept : base(nullptr), size(0), slot(-1) {}
+
+executor::WriteWatch::~WriteWatch() {
+	stop();
+}
+
+void executor::WriteWatch::watch(char* const addr, const size_t bytes) {
+	stop();
+	installFaultHandler();
+
+	base = addr;
+	size = vmem::roundUp(bytes);
+	dirty = std::make_unique<std::atomic<bool>[]>(size / vmem::pageSize());
+
+	for (int i = 0; i < MAX_WATCHES; i++) {
+		WriteWatch* expected = nullptr;
+		if (watchSlots[i].watch.compare_exchange_strong(expected, this)) {
+			slot = i;
+			break;
+		}
+	}
+	if (slot < 0) throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, 0, "Too many write watches");
+
+	vmem::protect(base, size, false);
+}
+
+void executor::WriteWatch::stop() noexcept {
+	if (slot < 0) return;
+
+	WatchSlot& s = watchSlots[slot];
+	s.watch = nullptr;
+	while (s.users.load()) std::this_thread::yield();
+	slot = -1;
+
+	vmem::protect(base, size, true);
+}
+
+char* executor::WriteWatch::begin() const noexcept {
+	return base;
+}
+
+size_t executor::WriteWatch::getPages() const noexcept {
+	return slot < 0 ? 0 : size / vmem::pageSize();
+}
+
+bool executor::WriteWatch::isDirty(const size_t page) const noexcept {
+	return dirty[page].load(std::memory_order_relaxed);
+}
+
+bool executor::WriteWatch::handleFault(const void* const addr) noexcept {
+	const char* const ptr = static_cast<const char*>(addr);
+	if (ptr < base || ptr >= base + size) return false;
+
+	const size_t page = vmem::pageSize();
+	const size_t index = (ptr - base) / page;
+	dirty[index].store(true, std::memory_order_relaxed);
+	return vmem::protect(base + index * page, page, true);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Sampling
+
+namespace {
+	// Asks a VM's sampler for call stack samples at a steady rate, for as long as it exists
+	// On POSIX it's a profiling interval timer, so it ticks with CPU time. There's only one of those per process,
+	// so only one VM can be sampled at a time
+	class Sampler {
+	private:
+	#ifdef _WIN32
+		std::mutex mutex;
+		std::condition_variable stopped;
+		bool stopping;
+		std::thread ticker;
+	#else
+		static inline std::atomic<executor::StackSampler*> sampled{ nullptr };
+		struct sigaction prevProf {};
+
+		static void onTick(const int) {
+			if (executor::StackSampler* const sampler = sampled.load()) sampler->request();
+		}
 	#endif
-		switch (opcode) {
-			case NOP:
-				break;
-
-			case HALT:
-				goto end;
-
-			case BREAK:
-				while (instream.get() != '\n');
-				break;
-
-			case ALLOC: // TODO : Careful with the memory!
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				try {
-					charptr = new char[wordReg[rid2].word];
-					wordReg[rid1].word = reinterpret_cast<word_t>(charptr);
-					if (checkMem) {
-						memAllocs.push_back(charptr);
-					}
-				} catch (const std::bad_alloc& e) {
-					throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, program.offset(), e.what());
-				}
-				break;
-
-			case FREE:
-				program.read<reg_t>(&rid1);
-				charptr = reinterpret_cast<char*>(wordReg[rid1].word);
-				if (checkMem) {
-					memAllocs.remove(charptr);
-				}
-				delete[] charptr;
-				break;
-
-			case R_MOV_W:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				wordReg[rid1] = wordReg[rid2];
-				break;
-
-			case R_MOV_B:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[rid1] = byteReg[rid2];
-				break;
-
-			case MOV_W:
-				program.read<reg_t>(&rid1);
-				program.read<word_t>(&word);
-				wordReg[rid1].word = word;
-				break;
-
-			case MOV_B:
-				program.read<reg_t>(&rid1);
-				program.read<byte_t>(&byte);
-				byteReg[rid1].byte = byte;
-				break;
-
-			case LOAD_W:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<word_t>(&word);
-				wordReg[rid1].word = *reinterpret_cast<word_t*>(wordReg[rid2].word + word);
-				break;
-
-			case STORE_W:
-				program.read<reg_t>(&rid1);
-				program.read<word_t>(&word);
-				program.read<reg_t>(&rid2);
-				*reinterpret_cast<word_t*>(wordReg[rid1].word + word) = wordReg[rid2].word;
-				break;
-
-			case LOAD_B:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<word_t>(&word);
-				byteReg[rid1].byte = *reinterpret_cast<byte_t*>(wordReg[rid2].word + word);
-				break;
-
-			case STORE_B:
-				program.read<reg_t>(&rid1);
-				program.read<word_t>(&word);
-				program.read<reg_t>(&rid2);
-				*reinterpret_cast<byte_t*>(wordReg[rid1].word + word) = byteReg[rid2].byte;
-				break;
-
-			case JMP:
-				program.read<word_t>(&word);
-				program.goto_(word);
-				break;
-
-			case JMP_Z:
-				program.read<word_t>(&word);
-				if (byteReg[reg::FZ].bool_ == 0) {
-					program.goto_(word);
-				}
-				break;
-
-			case JMP_NZ:
-				program.read<word_t>(&word);
-				if (byteReg[reg::FZ].bool_ != 0) {
-					program.goto_(word);
-				}
-				break;
-
-			case R_JMP:
-				program.read<reg_t>(&rid1);
-				program.goto_(wordReg[rid1].word);
-				break;
-
-			case R_JMP_Z:
-				program.read<reg_t>(&rid1);
-				if (byteReg[reg::FZ].bool_ == 0) {
-					program.goto_(wordReg[rid1].word);
-				}
-				break;
-
-			case R_JMP_NZ:
-				program.read<reg_t>(&rid1);
-				if (byteReg[reg::FZ].bool_ != 0) {
-					program.goto_(wordReg[rid1].word);
-				}
-				break;
-
-			case I_FLAG:
-				program.read<reg_t>(&rid1);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				// TODO : Set other flags if they exist?
-				break;
-
-			case I_CMP_EQ:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == wordReg[rid2].int_ ? 1 : 0;
-				break;
-
-			case I_CMP_NE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ != wordReg[rid2].int_ ? 1 : 0;
-				break;
-
-			case I_CMP_GT:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ > wordReg[rid2].int_ ? 1 : 0;
-				break;
-
-			case I_CMP_LT:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ < wordReg[rid2].int_ ? 1 : 0;
-				break;
-
-			case I_CMP_GE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ >= wordReg[rid2].int_ ? 1 : 0;
-				break;
-
-			case I_CMP_LE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ <= wordReg[rid2].int_ ? 1 : 0;
-				break;
-
-			case I_INC:
-				program.read<reg_t>(&rid1);
-				wordReg[rid1].int_++;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_DEC:
-				program.read<reg_t>(&rid1);
-				wordReg[rid1].int_--;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_ADD:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				wordReg[rid1].int_ = wordReg[rid2].int_ + wordReg[rid3].int_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_SUB:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				wordReg[rid1].int_ = wordReg[rid2].int_ - wordReg[rid3].int_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_MUL:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				wordReg[rid1].int_ = wordReg[rid2].int_ * wordReg[rid3].int_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_DIV:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				if (wordReg[rid3].int_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
-				wordReg[rid1].int_ = wordReg[rid2].int_ / wordReg[rid3].int_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_MOD:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				if (wordReg[rid3].int_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
-				wordReg[rid1].int_ = wordReg[rid2].int_ % wordReg[rid3].int_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
-				break;
-
-			case I_TO_C:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[rid1].char_ = static_cast<char_t>(wordReg[rid2].int_);
-				break;
-
-			case I_TO_F:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				wordReg[rid1].float_ = static_cast<types::float_t>(wordReg[rid2].int_);
-				break;
-
-			case C_FLAG:
-				program.read<reg_t>(&rid1);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				// TODO : Set other flags if they exist?
-				break;
-
-			case C_CMP_EQ:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == byteReg[rid2].char_ ? 1 : 0;
-				break;
-
-			case C_CMP_NE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ != byteReg[rid2].char_ ? 1 : 0;
-				break;
-
-			case C_CMP_GT:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ > byteReg[rid2].char_ ? 1 : 0;
-				break;
-
-			case C_CMP_LT:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ < byteReg[rid2].char_ ? 1 : 0;
-				break;
-
-			case C_CMP_GE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ >= byteReg[rid2].char_ ? 1 : 0;
-				break;
-
-			case C_CMP_LE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ <= byteReg[rid2].char_ ? 1 : 0;
-				break;
-
-			case C_INC:
-				program.read<reg_t>(&rid1);
-				byteReg[rid1].char_++;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_DEC:
-				program.read<reg_t>(&rid1);
-				byteReg[rid1].char_--;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_ADD:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				byteReg[rid1].char_ = byteReg[rid2].char_ + byteReg[rid3].char_;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_SUB:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				byteReg[rid1].char_ = byteReg[rid2].char_ - byteReg[rid3].char_;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_MUL:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				byteReg[rid1].char_ = byteReg[rid2].char_ * byteReg[rid3].char_;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_DIV:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				if (byteReg[rid3].char_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
-				byteReg[rid1].char_ = byteReg[rid2].char_ / byteReg[rid3].char_;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_MOD:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				if (byteReg[rid3].char_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
-				byteReg[rid1].char_ = byteReg[rid2].char_ % byteReg[rid3].char_;
-				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
-				break;
-
-			case C_TO_I:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				wordReg[rid1].int_ = static_cast<char_t>(byteReg[rid2].char_);
-				break;
-
-			case C_TO_F:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				wordReg[rid1].float_ = static_cast<types::float_t>(byteReg[rid2].char_);
-				break;
-
-			case F_FLAG:
-				program.read<reg_t>(&rid1);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
-				// TODO : Set other flags if they exist?
-				break;
-
-			case F_CMP_EQ:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == wordReg[rid2].float_ ? 1 : 0;
-				break;
-
-			case F_CMP_NE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ != wordReg[rid2].float_ ? 1 : 0;
-				break;
-
-			case F_CMP_GT:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ > wordReg[rid2].float_ ? 1 : 0;
-				break;
-
-			case F_CMP_LT:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ < wordReg[rid2].float_ ? 1 : 0;
-				break;
-
-			case F_CMP_GE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ >= wordReg[rid2].float_ ? 1 : 0;
-				break;
-
-			case F_CMP_LE:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ <= wordReg[rid2].float_ ? 1 : 0;
-				break;
-
-			case F_ADD:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				wordReg[rid1].float_ = wordReg[rid2].float_ + wordReg[rid3].float_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
-				break;
-
-			case F_SUB:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				wordReg[rid1].float_ = wordReg[rid2].float_ - wordReg[rid3].float_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
-				break;
-
-			case F_MUL:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				wordReg[rid1].float_ = wordReg[rid2].float_ * wordReg[rid3].float_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
-				break;
-
-			case F_DIV:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				if (wordReg[rid3].float_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
-				wordReg[rid1].float_ = wordReg[rid2].float_ / wordReg[rid3].float_;
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
-				break;
-
-			case F_MOD:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				program.read<reg_t>(&rid3);
-				if (wordReg[rid3].float_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
-				wordReg[rid1].float_ = wordReg[rid2].float_ * modf(wordReg[rid2].float_ / wordReg[rid3].float_, &float_);
-				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
-				break;
-
-			case F_TO_C:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				byteReg[rid1].char_ = static_cast<char_t>(wordReg[rid2].float_);
-				break;
-
-			case F_TO_I:
-				program.read<reg_t>(&rid1);
-				program.read<reg_t>(&rid2);
-				wordReg[rid1].int_ = static_cast<int_t>(wordReg[rid2].float_);
-				break;
-
-			case PRNT_C:
-				program.read<reg_t>(&rid1);
-				outstream << byteReg[rid1].char_;
-				break;
-
-			case PRNT_STR:
-				program.read<reg_t>(&rid1);
-				program.read<word_t>(&word);
-				outstream << reinterpret_cast<char*>(wordReg[rid1].word + word);
-				break;
-
-			case READ_C:
-				program.read<reg_t>(&rid1);
-				instream.get(rlchar);
-				byteReg[rid1].char_ = rlchar;
-				break;
-
-			case READ_STR:
-				program.read<reg_t>(&rid1);
-				program.read<word_t>(&word);
-				instream.getline(reinterpret_cast<char*>(wordReg[rid1].word + word), std::numeric_limits<std::streamsize>::max(), '\n');
-				break;
-
-			case R_PRNT_I:
-				program.read<reg_t>(&rid1);
-				outstream << wordReg[rid1].int_;
-				break;
-
-			case R_PRNT_F:
-				program.read<reg_t>(&rid1);
-				outstream << wordReg[rid1].float_;
-				break;
-
-			case PRNT_LN:
-				outstream << '\n';
-				break;
-
-			case TIME:
-				program.read<reg_t>(&rid1);
-				wordReg[rid1].int_ = static_cast<int_t>(std::time(nullptr));
-				break;
 
-			default:
-				throw ExecutorException(ExecutorException::ErrorType::UNKNOWN_OPCODE, program.offset());
-				break;
+	public:
+		Sampler(executor::StackSampler* const sampler, const int hz)
+		#ifdef _WIN32
+			: stopping(false)
+		#endif
+		{
+			if (!sampler || hz <= 0) return;
+
+		#ifdef _WIN32
+			// No interval timers, so a thread does the ticking, in wall clock time
+			ticker = std::thread([this, sampler, period = std::chrono::microseconds(1000000 / hz)] {
+				std::unique_lock<std::mutex> lock(mutex);
+				while (!stopped.wait_for(lock, period, [this] { return stopping; })) sampler->request();
+			});
+		#else
+			sampled = sampler;
+			struct sigaction action {};
+			action.sa_handler = onTick;
+			// So that ticks don't interrupt reads of the input stream
+			action.sa_flags = SA_RESTART;
+			sigemptyset(&action.sa_mask);
+			sigaction(SIGPROF, &action, &prevProf);
+
+			itimerval timer {};
+			timer.it_interval.tv_sec = 0;
+			timer.it_interval.tv_usec = std::max(1000000 / hz, 1);
+			timer.it_value = timer.it_interval;
+			setitimer(ITIMER_PROF, &timer, nullptr);
+		#endif
+		}
+
+		~Sampler() {
+		#ifdef _WIN32
+			if (!ticker.joinable()) return;
+			{
+				const std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			stopped.notify_one();
+			ticker.join();
+		#else
+			if (!sampled.load()) return;
+			const itimerval timer {};
+			setitimer(ITIMER_PROF, &timer, nullptr);
+			sigaction(SIGPROF, &prevProf, nullptr);
+			sampled = nullptr;
+		#endif
+		}
+
+		Sampler(const Sampler&) = delete;
+		Sampler& operator=(const Sampler&) = delete;
+	};
+
+	// Reads the assembler's --symbols file into a map from offsets to labels, without their @
+	std::map<bytecode::types::word_t, std::string> readSymbols(const char* const path, std::ostream& outstream) {
+		std::map<bytecode::types::word_t, std::string> symbols;
+		if (!path) return symbols;
+
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			outstream << IO_WARN "Could not open symbols \"" << path << "\", so frames are left as offsets" IO_NORM "\n";
+			return symbols;
+		}
+
+		bytecode::types::word_t offset;
+		std::string label;
+		while (file >> offset >> label) {
+			symbols[offset] = label[0] == '@' ? label.substr(1) : label;
+		}
+		return symbols;
+	}
+
+	// A stack from callStack as one line, with its frames from the outermost in, split by ';'
+	// Each frame is named by the last label at or before it, or left as an offset without symbols
+	std::string foldStack(const std::vector<bytecode::types::word_t>& stack, const std::map<bytecode::types::word_t, std::string>& symbols) {
+		std::string line;
+		for (auto frame = stack.rbegin(); frame != stack.rend(); ++frame) {
+			if (!line.empty()) line += ';';
+			auto it = symbols.upper_bound(*frame);
+			line += it == symbols.begin() ? "BYTE" + std::to_string(*frame) : (--it)->second;
+		}
+		return line;
+	}
+
+	// Writes the VM's samples as folded stacks: each stack's frames from the outermost in, split by ';', then its count
+	void writeSamples(executor::VM& vm, const executor::ExecutorSettings& settings, std::ostream& outstream) {
+		if (settings.sampleHz <= 0 || !settings.samplePath) return;
+
+		const std::map<bytecode::types::word_t, std::string> symbols = readSymbols(settings.symbolsPath, outstream);
+
+		// Different offsets in the same label fold together
+		std::map<std::string, uint64_t> folded;
+		uint64_t total = 0;
+		for (const auto& [stack, count] : vm.getSampler()->getSamples()) {
+			folded[foldStack(stack, symbols)] += count;
+			total += count;
+		}
+
+		std::ofstream file(settings.samplePath, std::ios::out | std::ios::trunc);
+		for (const auto& [line, count] : folded) {
+			file << line << " " << count << "\n";
+		}
+		if (!file) {
+			outstream << IO_WARN "Could not write samples to \"" << settings.samplePath << "\"" IO_NORM "\n";
+			return;
+		}
+		outstream << IO_MAIN "Wrote " << total << " samples to \"" << settings.samplePath << "\"\n" IO_NORM;
+	}
+
+	// How many allocation sites the heap profile lists
+	constexpr size_t HEAP_REPORT_SITES = 10;
+
+	// Prints where ALLOC was called from the most, and where what it allocated was never freed
+	void reportHeap(executor::VM& vm, const executor::ExecutorSettings& settings, std::ostream& outstream) {
+		const executor::HeapProfile* const profile = vm.getHeapProfile();
+		if (!profile) return;
+
+		std::vector<const executor::HeapProfile::Site*> sites;
+		uint64_t count = 0, bytes = 0;
+		for (const executor::HeapProfile::Site& site : profile->getSites()) {
+			sites.push_back(&site);
+			count += site.count;
+			bytes += site.bytes;
+		}
+		std::sort(sites.begin(), sites.end(), [](const auto* const a, const auto* const b) { return a->bytes > b->bytes; });
+
+		const std::map<bytecode::types::word_t, std::string> symbols = readSymbols(settings.symbolsPath, outstream);
+		const auto writeSites = [&](const auto& which) {
+			outstream << std::setw(10) << "count" << std::setw(14) << "bytes" << std::setw(12) << "mean size" << std::setw(14) << "mean life"
+				<< std::setw(10) << "leaked" << std::setw(14) << "leaked bytes" << "  site\n";
+			for (const executor::HeapProfile::Site* const site : which) {
+				outstream << std::setw(10) << site->count << std::setw(14) << site->bytes << std::setw(12) << site->bytes / site->count
+					<< std::setw(14) << (site->freed ? std::to_string(site->lifetime / site->freed) : "-")
+					<< std::setw(10) << site->liveCount << std::setw(14) << site->liveBytes << "  " << foldStack(site->stack, symbols) << "\n";
+			}
+		};
+
+		outstream << IO_MAIN "Heap profile: " << count << " allocations of " << bytes << " bytes in all, with at most "
+			<< profile->getPeakBytes() << " bytes allocated at once. Lifetimes are in instructions\n" IO_NORM;
+		if (sites.empty()) return;
+		writeSites(std::vector<const executor::HeapProfile::Site*>(sites.begin(), sites.begin() + std::min(sites.size(), HEAP_REPORT_SITES)));
+
+		std::vector<const executor::HeapProfile::Site*> leaks;
+		std::copy_if(sites.begin(), sites.end(), std::back_inserter(leaks), [](const auto* const site) { return site->liveCount > 0; });
+		if (leaks.empty()) return;
+		outstream << IO_WARN "Leaked allocations:\n" IO_NORM;
+		writeSites(leaks);
+	}
+
+	// Writes which blocks and branches ran, for the disassembler's --coverage
+	void writeCoverage(executor::VM& vm, const executor::ExecutorSettings& settings, std::ostream& outstream) {
+		executor::CoverageCounter* const counter = vm.getCoverageCounter();
+		if (!counter || !vm.getProgram()) return;
+
+		const executor::Coverage coverage = counter->total(*vm.getProgram());
+		std::ofstream file(settings.coveragePath, std::ios::out | std::ios::trunc);
+		coverage.write(file);
+		if (!file) {
+			outstream << IO_WARN "Could not write coverage to \"" << settings.coveragePath << "\"" IO_NORM "\n";
+			return;
+		}
+
+		const size_t ran = std::count_if(coverage.blocks.begin(), coverage.blocks.end(), [](const executor::Block& block) { return block.count > 0; });
+		outstream << IO_MAIN << ran << " of " << coverage.blocks.size() << " blocks ran, written to \"" << settings.coveragePath << "\"\n" IO_NORM;
+	}
+
+	// Prints what BENCH_BEGIN and BENCH_END measured, if anything
+	void reportBench(const executor::VM& vm, std::ostream& outstream) {
+		const auto& regions = vm.getBenchRegions();
+		if (regions.empty()) return;
+
+		outstream << IO_MAIN "Benchmark regions:\n" IO_NORM;
+		outstream << std::setw(10) << "region" << std::setw(12) << "count" << std::setw(16) << "total ns"
+			<< std::setw(14) << "mean ns" << std::setw(14) << "min ns" << std::setw(14) << "max ns" << "\n";
+		for (const auto& [id, region] : regions) {
+			outstream << std::setw(10) << id << std::setw(12) << region.count << std::setw(16) << region.totalNs
+				<< std::setw(14) << region.totalNs / static_cast<int64_t>(region.count) << std::setw(14) << region.minNs
+				<< std::setw(14) << region.maxNs << "\n";
+		}
+	}
+
+	// Prints what the interpreter spent on each opcode, most expensive first, if it was profiling
+	void reportOpcodes(executor::VM& vm, std::ostream& outstream) {
+		executor::OpcodeProfile* const profile = vm.getOpcodeProfile();
+		if (!profile) return;
+
+		const std::vector<executor::OpcodeProfile::Cost> costs = profile->total();
+		// Each opcode's samples stand in for all its dispatches
+		std::vector<std::pair<double, int>> estimates;
+		double total = 0;
+		for (int i = 0; i < bytecode::opcodeCount; i++) {
+			if (!costs[i].dispatches) continue;
+			const double estimate = costs[i].samples ? static_cast<double>(costs[i].cycles) / costs[i].samples * costs[i].dispatches : 0;
+			estimates.emplace_back(estimate, i);
+			total += estimate;
+		}
+		std::sort(estimates.begin(), estimates.end(), std::greater<>());
+
+		outstream << IO_MAIN "Interpreter profile, timing one dispatch in " << executor::OPCODE_SAMPLE_INTERVAL << ":\n" IO_NORM;
+		outstream << std::setw(14) << "opcode" << std::setw(16) << "dispatches" << std::setw(12) << "samples"
+			<< std::setw(14) << "mean cycles" << std::setw(10) << "share" << "\n";
+		for (const auto& [estimate, op] : estimates) {
+			const executor::OpcodeProfile::Cost& cost = costs[op];
+			outstream << std::setw(14) << bytecode::opcodeStrings[op] << std::setw(16) << cost.dispatches << std::setw(12) << cost.samples
+				<< std::setw(14) << std::fixed << std::setprecision(1) << (cost.samples ? static_cast<double>(cost.cycles) / cost.samples : 0.0)
+				<< std::setw(9) << (total > 0 ? estimate / total * 100 : 0.0) << "%" << std::defaultfloat << "\n";
+		}
+	}
+
+	// Has the VM publish live metrics for /stat, if the settings ask for them
+	void startMetrics(executor::VM& vm, const executor::ExecutorSettings& settings, std::ostream& outstream) {
+		if (settings.metricsInterval <= 0) return;
+
+		std::unique_ptr<executor::Metrics> metrics = executor::Metrics::create(readSymbols(settings.symbolsPath, outstream));
+		if (!metrics) {
+			outstream << IO_WARN "Could not make shared memory for metrics, so they won't be published" IO_NORM "\n";
+			return;
+		}
+		outstream << IO_MAIN "Publishing metrics, read them with /stat " << executor::processId() << "\n" IO_NORM;
+		vm.setMetrics(std::move(metrics));
+	}
+
+	// Has the VM record what it takes from outside, if the settings ask for it. The recording starts with a snapshot,
+	// so this has to come before the VM runs
+	void startRecording(executor::VM& vm, const executor::ExecutorSettings& settings, std::ostream& outstream) {
+		if (!settings.recordPath) return;
+
+		std::ostringstream snapshot;
+		vm.snapshot(snapshot);
+		std::unique_ptr<executor::Recording> recording = executor::Recording::record(
+			std::make_unique<std::ofstream>(settings.recordPath, std::ios::out | std::ios::binary | std::ios::trunc), snapshot.str());
+		if (!recording) {
+			outstream << IO_WARN "Could not write a recording to \"" << settings.recordPath << "\", so the run isn't being recorded" IO_NORM "\n";
+			return;
+		}
+		vm.setRecording(std::move(recording));
+	}
+
+	// Runs a loaded VM, sampling it and publishing metrics if the settings ask, and then gives every report they ask for
+	int runAndReport(executor::VM& vm, const executor::ExecutorSettings& settings, std::ostream& outstream) {
+		startMetrics(vm, settings, outstream);
+		{
+			const Sampler sampler(vm.getSampler(), settings.sampleHz);
+			vm.run();
+		}
+		writeSamples(vm, settings, outstream);
+		writeCoverage(vm, settings, outstream);
+		reportBench(vm, outstream);
+		reportOpcodes(vm, outstream);
+		reportHeap(vm, settings, outstream);
+
+		// Warn about things that weren't already deallocated (the VM deallocates them)
+		if (settings.checksMemory() && vm.getAllocationCount()) {
+			outstream << IO_WARN "Found " << vm.getAllocationCount() << " unfreed memory allocations" IO_NORM "\n";
 		}
+
+		outstream << IO_END;
+
+		return 0;
 	}
 
-end:;
-	// Warn and deallocate things that weren't already deallocated
-	if (checkMem && !memAllocs.empty()) {
-		outstream << IO_WARN "Found " << memAllocs.size() << " unfreed memory allocations" IO_NORM "\n";
-		for (const char* const ptr : memAllocs) {
-			delete[] ptr;
+	// Runs one of the underscored executor functions on std::cout and std::cin, printing what it's attempting on path,
+	// and how that went
+	int attempt(const char* const attempting, const char* const path, const std::function<int()>& run) {
+		using executor::ExecutorException;
+		using std::cout;
+
+		cout << IO_MAIN << attempting << " \"" << path << "\"\n" IO_NORM;
+
+		try {
+			const int out = run();
+			cout << IO_MAIN "Execution finished with code: " << out << IO_NORM IO_END;
+			return out;
+		} catch (const ExecutorException& e) {
+			cout << IO_ERR "Error during execution at BYTE" << e.getLoc() << " : " << e.what() << IO_NORM IO_END;
+		} catch (const std::exception& e) {
+			cout << IO_ERR "An unknown error occurred during execution. This error is most likely an issue with the c++ executor code, not your code. Sorry. The provided error message is as follows:\n" << e.what() << IO_NORM IO_END;
 		}
+
+		return 1;
 	}
+}
 
-	outstream << IO_END;
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Executor Functions
+
+int executor::exec(const char* const path, const ExecutorSettings& settings) {
+	return attempt("Attempting to execute file", path, [&] {
+		std::fstream file;
+		file.open(path, std::ios::in | std::ios::binary);
+		return executor::exec_(file, settings, std::cout, std::cin);
+	});
+}
 
-	return 0;
+int executor::exec_(std::iostream& file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream) {
+	VM vm(settings);
+	vm.setStreams(instream, outstream);
+	vm.load(std::make_shared<const bytecode::Image>(file));
+	startRecording(vm, settings, outstream);
+	return runAndReport(vm, settings, outstream);
+}
+
+int executor::restore(const char* const path, const ExecutorSettings& settings) {
+	return attempt("Attempting to restore snapshot", path, [&] {
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		return executor::restore_(file, settings, std::cout, std::cin);
+	});
+}
+
+int executor::restore_(std::istream& file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream) {
+	VM vm(settings);
+	vm.setStreams(instream, outstream);
+	vm.restore(file);
+	startRecording(vm, settings, outstream);
+	return runAndReport(vm, settings, outstream);
+}
+
+int executor::replay(const char* const path, const ExecutorSettings& settings) {
+	return attempt("Attempting to replay recording", path, [&] {
+		return executor::replay_(std::make_unique<std::ifstream>(path, std::ios::in | std::ios::binary), settings, std::cout, std::cin);
+	});
+}
+
+int executor::replay_(std::unique_ptr<std::istream> file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream) {
+	std::string snapshot;
+	std::unique_ptr<Recording> recording = Recording::replay(std::move(file), snapshot);
+	if (!recording) throw ExecutorException(ExecutorException::ErrorType::BAD_SNAPSHOT, 0, "not a recording");
+
+	VM vm(settings);
+	// Nothing is read from instream, except by BREAK
+	vm.setStreams(instream, outstream);
+	{
+		std::istringstream in(snapshot);
+		vm.restore(in);
+	}
+	vm.setRecording(std::move(recording));
+	return runAndReport(vm, settings, outstream);
 }
\ No newline at end of file
@@ -2,23 +2,90 @@
 #include "../utils/flags.h"
 #include <stdexcept>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 
 namespace executor {
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Constants?
 
+	// Default stack size. Only address space is reserved up front, pages are committed as the stack grows into them
+	constexpr int DEFAULT_STACK_SIZE = 0x1000000;
+	// Default stack size for tasks. Small, since there can be tens of thousands of them and each is fully allocated
+	constexpr int DEFAULT_TASK_STACK_SIZE = 0x1000;
+	// Default heap size. Like the stack, it is reserved up front and committed as it fills
+	constexpr int DEFAULT_HEAP_SIZE = 0x4000000;
+	// How much fuel can be spent between checks of the wall clock, when there is a timeout
+	constexpr int64_t CLOCK_CHECK_INTERVAL = 0x10000;
+	// Default time between checkpoints
+	constexpr int64_t DEFAULT_CHECKPOINT_MS = 60000;
+	// Offsets into files for FILE_MAP are counted in blocks this big, so a program can reach past 2GB in a file
+	// A multiple of the page size, and of how finely Windows can place a view
+	constexpr int64_t FILE_BLOCK = 0x10000;
+	// Default number of host threads for AIO_READ and AIO_WRITE. They spend most of their time blocked, so cores don't matter
+	constexpr int DEFAULT_IO_WORKERS = 4;
+	// With FLAG_PROFILE_OPCODES, one dispatch in this many is timed. Prime, so it doesn't keep landing on the same
+	// instruction of a loop
+	constexpr int OPCODE_SAMPLE_INTERVAL = 61;
+	// The most frames the profilers follow down one call stack
+	constexpr int MAX_STACK_DEPTH = 256;
+	// Default instructions between publishing live metrics. A few times a second, at full speed
+	constexpr int64_t DEFAULT_METRICS_INTERVAL = 0x4000000;
+
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Executor Settings
 
+	// Scribbles over freed blocks and warns about leaks, but only along with FLAG_DEBUG
 	static constexpr int FLAG_CHECK_MEM = Flags::FLAG_FIRST_FREE;
+	// Prints every instruction before it runs
+	static constexpr int FLAG_TRACE = FLAG_CHECK_MEM << 1;
+	// Counts how often each opcode runs, and times a sample of them, to find what the interpreter spends its time on
+	static constexpr int FLAG_PROFILE_OPCODES = FLAG_TRACE << 1;
+	// Tracks every allocation, to report where the heap goes and what leaks
+	static constexpr int FLAG_PROFILE_HEAP = FLAG_PROFILE_OPCODES << 1;
 
 	// Holds settings info about the execution process
 	struct ExecutorSettings {
 		Flags flags;
 		int stackSize;
+		int taskStackSize;
+		int heapSize;
+		// Host threads for running PARFOR loops, or 0 for one per core
+		int workers;
+		// Host threads for AIO_READ and AIO_WRITE
+		int ioWorkers;
+		// Instructions to run before stopping, or 0 for no limit
+		// Only counted at backward branches and register jumps, so straight-line code is free
+		int64_t maxInstructions;
+		// Milliseconds to run before stopping, or 0 for no limit
+		int64_t timeoutMs;
+		// Where SNAPSHOT saves the program before stopping it, or null to make SNAPSHOT do nothing
+		const char* snapshotPath;
+		// Where POPEN looks for segments, or null for the current directory
+		const char* segmentDir;
+		// Where checkpoints are kept, or null for none
+		const char* checkpointPath;
+		int64_t checkpointMs;
+		// How many times a second of CPU time to sample the guest's call stack, or 0 for never
+		int sampleHz;
+		// Where the samples are written, as folded stacks for flame graph tools
+		const char* samplePath;
+		// Labels from the assembler's --symbols, to name the frames by, or null to leave them as offsets
+		const char* symbolsPath;
+		// Where to write which blocks and branches ran, or null to not count them
+		const char* coveragePath;
+		// Instructions each thread runs between publishing live metrics for /stat, or 0 to not publish them
+		int64_t metricsInterval;
+		// Where to record everything the run takes from outside, for replay, or null to not record it
+		const char* recordPath;
 
 		ExecutorSettings() noexcept;
+
+		// Whether FLAG_CHECK_MEM is on, which takes FLAG_DEBUG too
+		[[nodiscard]] bool checksMemory() const noexcept;
 	};
 
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -30,13 +97,57 @@ namespace executor {
 		enum class ErrorType {
 			UNKNOWN_OPCODE,
 			DIVIDE_BY_ZERO,
-			BAD_ALLOC
+			BAD_ALLOC,
+			STACK_OVERFLOW,
+			INSTRUCTION_LIMIT,
+			TIMEOUT,
+			BAD_MANIFEST,
+			BAD_THREAD,
+			MISALIGNED_ATOMIC,
+			THREAD_STOPPED,
+			BAD_TASK,
+			DEADLOCK,
+			BAD_PORT,
+			CHANNEL_CLOSED,
+			BAD_TOPOLOGY,
+			BAD_FREE,
+			BAD_SNAPSHOT,
+			CLONE_FAILED,
+			BAD_SEGMENT,
+			BAD_FILE,
+			BAD_TICKET,
+			UNKNOWN_NATIVE,
+			BAD_BASE,
+			BAD_REGION,
+			REPLAY_DIVERGED
 		};
 
 		static constexpr const char* const errorTypeStrings[] = {
 			"Unknown opcode",
 			"Division (or modulo) by zero",
-			"Dynamic memory allocation error"
+			"Dynamic memory allocation error",
+			"Stack overflow",
+			"Instruction limit reached",
+			"Time limit reached",
+			"Invalid batch manifest",
+			"Invalid thread handle",
+			"Misaligned atomic memory access",
+			"Thread stopped",
+			"Invalid task handle",
+			"Deadlock, every task is waiting",
+			"No channel bound to port",
+			"Channel closed",
+			"Invalid topology",
+			"Freeing memory that wasn't allocated",
+			"Invalid snapshot",
+			"Could not clone the VM",
+			"Could not open persistent segment",
+			"Invalid file handle or mapping",
+			"Invalid I/O ticket",
+			"No native function with that name",
+			"Number base must be from 2 to 36",
+			"benchend doesn't match the last benchbegin",
+			"Replay went differently from its recording"
 		};
 
 	private:
@@ -54,14 +165,98 @@ namespace executor {
 	// The Stack
 
 	// Acts as the stack memory for the program execution
+	// The stack is a reserved region with an inaccessible guard page on either side. On Windows, pages are committed
+	// the first time they are touched, and elsewhere they're all mapped up front, to be backed as they're written
+	// Touching a guard page is reported as a stack overflow
 	class Stack {
+	public:
+		// What a memory fault meant to the stack
+		enum class Fault {
+			NONE,		// Not in the stack at all
+			COMMITTED,	// In the stack, and the page is now committed
+			GUARD		// In a guard page, meaning the stack overflowed
+		};
+
+	private:
+		char* base;
+		size_t reserved;
+		size_t usable;
+	#ifdef _WIN32
+		// How much of the stack, from begin(), has ever been committed since the last reset
+		size_t touched;
+	#endif
+		// Other address space the thread runs on, like the chunks its tasks' stacks come from, where any fault is an overflow
+		std::vector<std::pair<const char*, size_t>> guarded;
+		// The running task's stack, or null while the thread itself is running
+		const char* taskFrames;
+		size_t taskFramesSize;
+
+	public:
+		// Puts begin() at at, unless it is null
+		explicit Stack(const int size, char* const at = nullptr);
+		~Stack();
+
+		Stack(const Stack&) = delete;
+		Stack& operator=(const Stack&) = delete;
+
+		[[nodiscard]] char* begin() const noexcept;
+		[[nodiscard]] size_t getSize() const noexcept;
+		// How much of the stack, from begin(), has anything in it, in whole pages. Everything past it reads as zero
+		[[nodiscard]] size_t getTouched() const noexcept;
+		// Where the running code's frames are, as far as they can be read without faulting anything in: this stack, or
+		// the stack of the task running on it
+		[[nodiscard]] std::pair<const char*, const char*> getFrames() const noexcept;
+		// Points getFrames at a task's stack of size bytes at addr, or back at this stack if addr is null
+		void setFrames(const char* const addr, const size_t size) noexcept;
+		// Commits the first size bytes, for restoring a stack that had been used that far. Returns false if it can't
+		bool touch(const size_t size) noexcept;
+
+		// Empties the stack, leaving it committed as it was when it was made
+		void reset() noexcept;
+
+		// Counts a fault anywhere in size bytes at addr as this stack overflowing, until removeGuarded(addr)
+		void addGuarded(const char* const addr, const size_t size);
+		void removeGuarded(const char* const addr) noexcept;
+
+		// Commits the page containing addr if it is in the stack. Safe to call from a fault handler
+		Fault handleFault(const void* const addr) noexcept;
+
+		// Runs body(arg) with faults on this stack handled, returning false if it overflowed
+		// body must not own anything with a destructor, since an overflow jumps straight out of it
+		bool guard(void (*body)(void*), void* arg);
+	};
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Write Watching
+
+	// Finds out which pages of a region get written to, by making them read-only and catching the first write to each
+	// Writes are caught on every thread, so this covers memory shared by guest threads and PARFOR workers too
+	class WriteWatch {
 	private:
-		const std::unique_ptr<char[]> owner;
+		char* base;
+		size_t size;
+		std::unique_ptr<std::atomic<bool>[]> dirty;
+		// Where this is registered with the fault handler, or -1
+		int slot;
 
 	public:
-		explicit Stack(const int size);
+		WriteWatch() noexcept;
+		~WriteWatch();
+
+		WriteWatch(const WriteWatch&) = delete;
+		WriteWatch& operator=(const WriteWatch&) = delete;
+
+		// Starts watching a region of committed pages afresh, with none of them dirty
+		void watch(char* const addr, const size_t bytes);
+		// Stops watching, and makes the region writable again
+		void stop() noexcept;
 
 		[[nodiscard]] char* begin() const noexcept;
+		[[nodiscard]] size_t getPages() const noexcept;
+		[[nodiscard]] bool isDirty(const size_t page) const noexcept;
+
+		// Marks the page containing addr dirty and makes it writable, if it is being watched. Safe to call from a fault handler
+		bool handleFault(const void* const addr) noexcept;
 	};
 
 	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -70,4 +265,10 @@ namespace executor {
 	// Execute a .eze file with given settings
 	int exec(const char* const path, const ExecutorSettings& settings);
 	int exec_(std::iostream& file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream);
+	// Carry on with a program saved by SNAPSHOT
+	int restore(const char* const path, const ExecutorSettings& settings);
+	int restore_(std::istream& file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream);
+	// Run a recording again, exactly as it went, without reading any input
+	int replay(const char* const path, const ExecutorSettings& settings);
+	int replay_(std::unique_ptr<std::istream> file, const ExecutorSettings& settings, std::ostream& outstream, std::istream& instream);
 }
\ No newline at end of file
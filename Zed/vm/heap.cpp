@@ -0,0 +1,167 @@
+#include "heap.h"
+#include "executor.h"
+#include "../utils/vmem.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+	constexpr uint32_t LIVE = 0x4556494C;
+	constexpr uint32_t FREE = 0x45455246;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The Heap
+
+executor::Heap::Heap(const size_t size, char* const at) : base(nullptr), reserved(vmem::roundUp(size)), committed(0), top(GRANULE), freeLists{} {
+	base = at ? vmem::reserveAt(at, reserved) : vmem::reserve(reserved);
+	if (!base) throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, 0, "Could not reserve the heap");
+}
+
+executor::Heap::~Heap() {
+	vmem::release(base, reserved);
+}
+
+executor::Heap::Header* executor::Heap::header(const size_t offset) const noexcept {
+	return reinterpret_cast<Header*>(base + offset);
+}
+
+void executor::Heap::push(const size_t offset) noexcept {
+	Header* const block = header(offset);
+	const size_t list = std::min(block->size / GRANULE, SMALL_CLASSES + 1) - 1;
+
+	block->state = FREE;
+	*reinterpret_cast<uint32_t*>(block + 1) = freeLists[list];
+	freeLists[list] = static_cast<uint32_t>(offset);
+}
+
+size_t executor::Heap::takeLarge(const size_t size) noexcept {
+	uint32_t* link = &freeLists[SMALL_CLASSES];
+	while (*link) {
+		const size_t offset = *link;
+		Header* const block = header(offset);
+		uint32_t* const next = reinterpret_cast<uint32_t*>(block + 1);
+
+		if (block->size >= size) {
+			*link = *next;
+
+			// Give back what's left over, if it's worth keeping
+			const size_t rest = block->size - size;
+			if (rest >= 4 * GRANULE) {
+				block->size = static_cast<uint32_t>(size);
+				header(offset + size)->size = static_cast<uint32_t>(rest);
+				push(offset + size);
+			}
+			return offset;
+		}
+		link = next;
+	}
+	return 0;
+}
+
+char* executor::Heap::begin() const noexcept {
+	return base;
+}
+
+size_t executor::Heap::getSize() const noexcept {
+	return reserved;
+}
+
+size_t executor::Heap::getTop() const noexcept {
+	return top;
+}
+
+char* executor::Heap::allocate(const size_t size) noexcept {
+	if (size > reserved) return nullptr;
+	const size_t total = std::max((size + sizeof(Header) + GRANULE - 1) / GRANULE * GRANULE, GRANULE);
+	const size_t list = total / GRANULE - 1;
+
+	size_t offset = 0;
+	if (list < SMALL_CLASSES) {
+		offset = freeLists[list];
+		if (offset) freeLists[list] = *reinterpret_cast<uint32_t*>(header(offset) + 1);
+	} else {
+		offset = takeLarge(total);
+	}
+
+	if (!offset) {
+		if (total > reserved - top) return nullptr;
+		if (top + total > committed) {
+			const size_t want = std::min(vmem::roundUp(std::max(top + total - committed, COMMIT_STEP)), reserved - committed);
+			if (!vmem::commit(base + committed, want)) return nullptr;
+			committed += want;
+		}
+
+		offset = top;
+		top += total;
+		header(offset)->size = static_cast<uint32_t>(total);
+	}
+
+	header(offset)->state = LIVE;
+	return reinterpret_cast<char*>(header(offset) + 1);
+}
+
+bool executor::Heap::free(char* const ptr) noexcept {
+	if (ptr < base + GRANULE + sizeof(Header) || ptr >= base + top) return false;
+
+	const size_t offset = ptr - base - sizeof(Header);
+	if (offset % GRANULE || header(offset)->state != LIVE) return false;
+
+	push(offset);
+	return true;
+}
+
+size_t executor::Heap::blockSize(const char* const ptr) const noexcept {
+	if (ptr < base + GRANULE + sizeof(Header) || ptr >= base + top) return 0;
+
+	const size_t offset = ptr - base - sizeof(Header);
+	if (offset % GRANULE || header(offset)->state != LIVE) return 0;
+
+	return header(offset)->size - sizeof(Header);
+}
+
+void executor::Heap::reset() noexcept {
+	vmem::decommit(base, committed);
+	committed = 0;
+	top = GRANULE;
+	std::fill_n(freeLists, SMALL_CLASSES + 1, 0);
+}
+
+void executor::Heap::write(std::ostream& out) const {
+	writeState(out);
+	// top starts past the unused first granule, which isn't committed until the first block is
+	const size_t written = std::min(top, committed);
+	out.write(base, static_cast<std::streamsize>(written));
+	for (size_t i = written; i < top; i++) out.put('\0');
+}
+
+bool executor::Heap::read(std::istream& in) {
+	reset();
+	if (!readState(in)) return false;
+
+	in.read(base, static_cast<std::streamsize>(top));
+	return static_cast<bool>(in);
+}
+
+void executor::Heap::writeState(std::ostream& out) const {
+	const uint64_t used = top;
+	out.write(reinterpret_cast<const char*>(&used), sizeof(used));
+	out.write(reinterpret_cast<const char*>(freeLists), sizeof(freeLists));
+}
+
+bool executor::Heap::readState(std::istream& in) {
+	uint64_t used = 0;
+	uint32_t lists[SMALL_CLASSES + 1];
+	in.read(reinterpret_cast<char*>(&used), sizeof(used));
+	in.read(reinterpret_cast<char*>(lists), sizeof(lists));
+	if (!in || used < GRANULE || used > reserved) return false;
+
+	const size_t want = std::min(vmem::roundUp(static_cast<size_t>(used)), reserved);
+	if (want > committed) {
+		if (!vmem::commit(base + committed, want - committed)) return false;
+		committed = want;
+	}
+
+	top = static_cast<size_t>(used);
+	std::copy(std::begin(lists), std::end(lists), freeLists);
+	return true;
+}
\ No newline at end of file
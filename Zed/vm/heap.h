@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// The Heap
+
+	// Where ALLOC gets its memory, and where the program's own bytes (and so its globals) are kept
+	// It is one reserved region, so everything a program can point at is somewhere the VM knows about, and can be
+	// saved and put back at the same address. Blocks are carved off the top, and freed ones are kept by size for reuse
+	class Heap {
+	private:
+		static constexpr size_t GRANULE = 16;
+		// Blocks up to SMALL_CLASSES * GRANULE bytes get a list for their exact size, the rest share one first-fit list
+		static constexpr size_t SMALL_CLASSES = 64;
+		static constexpr size_t COMMIT_STEP = 0x10000;
+
+		// Sits right before every block's memory
+		struct Header {
+			uint32_t size;	// Of the whole block, header included
+			uint32_t state;
+		};
+
+		char* base;
+		size_t reserved;
+		size_t committed;
+		// Where the next new block goes. Starts at GRANULE, so that 0 can mean "no block"
+		size_t top;
+		// Offset of the first free block of each size, and then of the large ones. Each free block holds the next offset
+		uint32_t freeLists[SMALL_CLASSES + 1];
+
+		[[nodiscard]] Header* header(const size_t offset) const noexcept;
+		void push(const size_t offset) noexcept;
+		[[nodiscard]] size_t takeLarge(const size_t size) noexcept;
+
+	public:
+		// Reserves size bytes at at, or anywhere if at is null. Throws if that can't be done
+		Heap(const size_t size, char* const at);
+		~Heap();
+
+		Heap(const Heap&) = delete;
+		Heap& operator=(const Heap&) = delete;
+
+		[[nodiscard]] char* begin() const noexcept;
+		[[nodiscard]] size_t getSize() const noexcept;
+		// How far into the heap blocks have ever been handed out. Nothing past it is in use
+		[[nodiscard]] size_t getTop() const noexcept;
+
+		// Returns nullptr when the heap is full
+		[[nodiscard]] char* allocate(const size_t size) noexcept;
+		// Returns false, and does nothing, if ptr isn't a live block
+		bool free(char* const ptr) noexcept;
+		// How many bytes a live block has room for, which can be more than was asked for, or 0 if ptr isn't one
+		[[nodiscard]] size_t blockSize(const char* const ptr) const noexcept;
+		// Frees everything at once, and gives the memory back
+		void reset() noexcept;
+
+		// Saves everything in use, to be read back into a heap of the same size at the same address
+		void write(std::ostream& out) const;
+		// Returns false if the saved heap doesn't fit
+		bool read(std::istream& in);
+		// The same, but only how the heap is laid out and not what's in it, for when the contents are saved some other way
+		// Reading commits up to the saved top, but keeps whatever was already there
+		void writeState(std::ostream& out) const;
+		bool readState(std::istream& in);
+	};
+}
\ No newline at end of file
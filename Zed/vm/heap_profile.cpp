@@ -0,0 +1,62 @@
+#include "heap_profile.h"
+#include "stack_sampler.h"
+#include <algorithm>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Heap Profile
+
+executor::HeapProfile::HeapProfile() noexcept : liveBytes(0), peakBytes(0), clock(0) {}
+
+void executor::HeapProfile::allocated(const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program,
+									  const bytecode::types::word_t ip, const char* const ptr, const size_t size, const uint64_t ran) {
+	std::vector<bytecode::types::word_t> frames = callStack(stack, bp, program.size(), ip);
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	clock += ran;
+
+	const auto [found, added] = siteIndex.try_emplace(std::move(frames), sites.size());
+	if (added) sites.push_back(Site{ found->first });
+	Site& site = sites[found->second];
+	site.count++;
+	site.bytes += size;
+	site.liveCount++;
+	site.liveBytes += size;
+
+	live[ptr] = Live{ found->second, size, clock };
+	liveBytes += size;
+	peakBytes = std::max(peakBytes, liveBytes);
+}
+
+void executor::HeapProfile::freed(const char* const ptr, const uint64_t ran) noexcept {
+	const std::lock_guard<std::mutex> lock(mutex);
+	clock += ran;
+
+	const auto it = live.find(ptr);
+	if (it == live.end()) return;
+
+	Site& site = sites[it->second.site];
+	site.freed++;
+	site.lifetime += clock - it->second.born;
+	site.liveCount--;
+	site.liveBytes -= it->second.size;
+	liveBytes -= it->second.size;
+	live.erase(it);
+}
+
+void executor::HeapProfile::clear() noexcept {
+	const std::lock_guard<std::mutex> lock(mutex);
+	siteIndex.clear();
+	sites.clear();
+	live.clear();
+	liveBytes = 0;
+	peakBytes = 0;
+	clock = 0;
+}
+
+const std::vector<executor::HeapProfile::Site>& executor::HeapProfile::getSites() const noexcept {
+	return sites;
+}
+
+size_t executor::HeapProfile::getPeakBytes() const noexcept {
+	return peakBytes;
+}
\ No newline at end of file
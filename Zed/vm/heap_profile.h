@@ -0,0 +1,68 @@
+#pragma once
+#include "executor.h"
+#include "../utils/bytecode.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Heap Profile
+
+	// Where ALLOC was called from, and what came of it, with FLAG_PROFILE_HEAP
+	// Lifetimes are in instructions, on a clock each thread adds what it has run to whenever it allocates or frees
+	class HeapProfile {
+	public:
+		// Everything ALLOC handed out from one call stack. Stacks are as for sampling
+		struct Site {
+			std::vector<bytecode::types::word_t> stack;
+			uint64_t count = 0;
+			uint64_t bytes = 0;
+			// How many were freed, and how many instructions they lived for between them
+			uint64_t freed = 0;
+			uint64_t lifetime = 0;
+			// What hasn't been freed yet, which is what leaked once the program has finished
+			uint64_t liveCount = 0;
+			uint64_t liveBytes = 0;
+		};
+
+	private:
+		struct Live {
+			size_t site;
+			size_t size;
+			// The clock when it was allocated
+			uint64_t born;
+		};
+
+		std::map<std::vector<bytecode::types::word_t>, size_t> siteIndex;
+		std::vector<Site> sites;
+		std::unordered_map<const char*, Live> live;
+		size_t liveBytes;
+		size_t peakBytes;
+		uint64_t clock;
+		std::mutex mutex;
+
+	public:
+		HeapProfile() noexcept;
+
+		HeapProfile(const HeapProfile&) = delete;
+		HeapProfile& operator=(const HeapProfile&) = delete;
+
+		// ALLOC at ip handed out size bytes at ptr, to a thread with BP at bp on stack. ran is how many instructions the
+		// thread has run since it last told the profile anything
+		void allocated(const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program, const bytecode::types::word_t ip,
+					   const char* const ptr, const size_t size, const uint64_t ran);
+		// FREE took back what was at ptr
+		void freed(const char* const ptr, const uint64_t ran) noexcept;
+		// Starts over, as if nothing had been allocated
+		void clear() noexcept;
+
+		// Only meaningful while no other threads are running
+		[[nodiscard]] const std::vector<Site>& getSites() const noexcept;
+		// The most bytes that were allocated and not yet freed at once
+		[[nodiscard]] size_t getPeakBytes() const noexcept;
+	};
+}
\ No newline at end of file
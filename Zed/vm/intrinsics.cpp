@@ -0,0 +1,130 @@
+#include "intrinsics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Intrinsics
+
+void executor::intrinsics::sortInts(int32_t* const data, const size_t count) noexcept {
+	std::sort(data, data + count);
+}
+
+void executor::intrinsics::sortFloats(float* const data, const size_t count) noexcept {
+	// Moving the NaNs out of the way first leaves a range that < orders properly
+	float* const end = std::partition(data, data + count, [](const float f) { return !std::isnan(f); });
+	std::sort(data, end);
+}
+
+namespace {
+	// Halves the range without branching on the comparison, so there are no mispredictions to pay for
+	template<typename T>
+	size_t lowerBound(const T* const data, const size_t count, const T key) noexcept {
+		if (count == 0) return 0;
+
+		const T* base = data;
+		size_t length = count;
+		while (length > 1) {
+			const size_t half = length / 2;
+			base = base[half - 1] < key ? base + half : base;
+			length -= half;
+		}
+		return static_cast<size_t>(base - data) + (*base < key ? 1 : 0);
+	}
+}
+
+size_t executor::intrinsics::lowerBoundInt(const int32_t* const data, const size_t count, const int32_t key) noexcept {
+	return lowerBound(data, count, key);
+}
+
+size_t executor::intrinsics::lowerBoundFloat(const float* const data, const size_t count, const float key) noexcept {
+	return lowerBound(data, count, key);
+}
+
+namespace {
+	constexpr uint32_t PRIME1 = 0x9E3779B1u;
+	constexpr uint32_t PRIME2 = 0x85EBCA77u;
+	constexpr uint32_t PRIME3 = 0xC2B2AE3Du;
+	constexpr uint32_t PRIME4 = 0x27D4EB2Fu;
+	constexpr uint32_t PRIME5 = 0x165667B1u;
+
+	uint32_t rotl(const uint32_t x, const int r) noexcept {
+		return (x << r) | (x >> (32 - r));
+	}
+
+	// Guest data has no alignment to count on
+	uint32_t load32(const char* const p) noexcept {
+		uint32_t val;
+		std::memcpy(&val, p, sizeof(val));
+		return val;
+	}
+
+	uint32_t mix(const uint32_t acc, const uint32_t input) noexcept {
+		return rotl(acc + input * PRIME2, 13) * PRIME1;
+	}
+}
+
+uint32_t executor::intrinsics::hash(const char* const data, const size_t size) noexcept {
+	const char* p = data;
+	const char* const end = data + size;
+	uint32_t h;
+
+	if (size >= 16) {
+		uint32_t v1 = PRIME1 + PRIME2;
+		uint32_t v2 = PRIME2;
+		uint32_t v3 = 0;
+		uint32_t v4 = 0 - PRIME1;
+		const char* const limit = end - 16;
+		do {
+			v1 = mix(v1, load32(p));
+			v2 = mix(v2, load32(p + 4));
+			v3 = mix(v3, load32(p + 8));
+			v4 = mix(v4, load32(p + 12));
+			p += 16;
+		} while (p <= limit);
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+	} else {
+		h = PRIME5;
+	}
+
+	h += static_cast<uint32_t>(size);
+	for (; p + 4 <= end; p += 4) {
+		h = rotl(h + load32(p) * PRIME3, 17) * PRIME4;
+	}
+	for (; p < end; p++) {
+		h = rotl(h + static_cast<uint8_t>(*p) * PRIME5, 11) * PRIME1;
+	}
+
+	h ^= h >> 15;
+	h *= PRIME2;
+	h ^= h >> 13;
+	h *= PRIME3;
+	h ^= h >> 16;
+	return h;
+}
+
+void executor::intrinsics::seedRandom(uint32_t* const state, const uint32_t seed) noexcept {
+	uint32_t x = seed;
+	for (int i = 0; i < 4; i++) {
+		uint32_t z = (x += 0x9E3779B9u);
+		z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+		z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+		state[i] = z ^ (z >> 16);
+	}
+	// An all-zero state would only ever give zeroes
+	if (!(state[0] | state[1] | state[2] | state[3])) state[0] = 1;
+}
+
+uint32_t executor::intrinsics::nextRandom(uint32_t* const state) noexcept {
+	const uint32_t result = rotl(state[1] * 5, 7) * 9;
+	const uint32_t t = state[1] << 9;
+
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = rotl(state[3], 11);
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Intrinsics
+
+	// Host versions of the loops programs would otherwise spend most of their time in, run straight over guest memory
+	namespace intrinsics {
+		void sortInts(int32_t* const data, const size_t count) noexcept;
+		// NaNs go last
+		void sortFloats(float* const data, const size_t count) noexcept;
+
+		// The index of the first element of a sorted array that isn't less than key, or count if there isn't one
+		[[nodiscard]] size_t lowerBoundInt(const int32_t* const data, const size_t count, const int32_t key) noexcept;
+		[[nodiscard]] size_t lowerBoundFloat(const float* const data, const size_t count, const float key) noexcept;
+
+		// xxHash32, with a seed of 0
+		[[nodiscard]] uint32_t hash(const char* const data, const size_t size) noexcept;
+
+		// xoshiro128**, whose whole state is four words. Seeding spreads one word over them with SplitMix32
+		void seedRandom(uint32_t* const state, const uint32_t seed) noexcept;
+		[[nodiscard]] uint32_t nextRandom(uint32_t* const state) noexcept;
+	}
+}
\ No newline at end of file
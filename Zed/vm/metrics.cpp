@@ -0,0 +1,159 @@
+#include "metrics.h"
+#include "stack_sampler.h"
+#include "../utils/io_utils.h"
+#include "../utils/vmem.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr uint32_t METRICS_MAGIC = 0x5254535A;
+	constexpr uint32_t METRICS_VERSION = 1;
+	// How many times read tries to catch the values between writes
+	constexpr int READ_ATTEMPTS = 1000;
+
+	std::string metricsName(const int pid) {
+		return "zed-" + std::to_string(pid);
+	}
+
+	int64_t nowNs() noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int64_t epochMs() noexcept {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Live Metrics
+
+int executor::processId() noexcept {
+#ifdef _WIN32
+	return static_cast<int>(GetCurrentProcessId());
+#else
+	return static_cast<int>(getpid());
+#endif
+}
+
+executor::Metrics::Metrics(std::string name, Block* const block, const int owner) noexcept
+	: name(std::move(name)), block(block), owner(owner), lastInstructions(0), lastNs(nowNs()), retired(0) {}
+
+std::unique_ptr<executor::Metrics> executor::Metrics::create(std::map<bytecode::types::word_t, std::string> symbols) {
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "The sequence has to work between processes");
+
+	const int pid = processId();
+	std::string name = metricsName(pid);
+	char* const base = vmem::createNamed(name.c_str(), sizeof(Block));
+	if (!base) return nullptr;
+
+	// The memory starts out zeroed, so the sequence is already even
+	Block* const block = reinterpret_cast<Block*>(base);
+	block->values.startedMs = block->values.updatedMs = epochMs();
+	block->version = METRICS_VERSION;
+	std::atomic_thread_fence(std::memory_order_release);
+	block->magic = METRICS_MAGIC;
+
+	std::unique_ptr<Metrics> metrics(new Metrics(std::move(name), block, pid));
+	metrics->symbols = std::move(symbols);
+	return metrics;
+}
+
+std::unique_ptr<executor::Metrics> executor::Metrics::open(const int pid) {
+	std::string name = metricsName(pid);
+	char* const base = vmem::openNamed(name.c_str(), sizeof(Block));
+	if (!base) return nullptr;
+
+	Block* const block = reinterpret_cast<Block*>(base);
+	if (block->magic != METRICS_MAGIC || block->version != METRICS_VERSION) {
+		vmem::unmapFile(base, sizeof(Block));
+		return nullptr;
+	}
+	return std::unique_ptr<Metrics>(new Metrics(std::move(name), block, 0));
+}
+
+executor::Metrics::~Metrics() {
+	vmem::unmapFile(reinterpret_cast<char*>(block), sizeof(Block));
+	if (owner == processId()) vmem::removeNamed(name.c_str());
+}
+
+void executor::Metrics::publish(const uint64_t instructions, const uint64_t heapBytes, const uint64_t stackFrames, const bytecode::types::word_t ip) noexcept {
+	const int64_t now = nowNs();
+	const double seconds = static_cast<double>(now - lastNs) / 1e9;
+
+	const uint32_t sequence = block->sequence.load(std::memory_order_relaxed);
+	block->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	MetricsValues& values = block->values;
+	values.instructions = instructions;
+	if (seconds > 0) values.instructionsPerSecond = static_cast<double>(instructions - lastInstructions) / seconds;
+	values.heapBytes = heapBytes;
+	values.stackFrames = stackFrames;
+	values.ip = ip;
+	auto it = symbols.upper_bound(ip);
+	const char* const label = it == symbols.begin() ? "" : (--it)->second.c_str();
+	std::strncpy(values.label, label, sizeof(values.label) - 1);
+	values.label[sizeof(values.label) - 1] = '\0';
+	values.updatedMs = epochMs();
+
+	block->sequence.store(sequence + 2, std::memory_order_release);
+
+	lastInstructions = instructions;
+	lastNs = now;
+}
+
+void executor::Metrics::retire(const uint64_t interval, const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program,
+							   const uint64_t heapBytes) {
+	const uint64_t instructions = retired.fetch_add(interval, std::memory_order_relaxed) + interval;
+
+	const std::unique_lock<std::mutex> lock(publishing, std::try_to_lock);
+	if (!lock.owns_lock()) return;
+
+	const bytecode::types::word_t ip = program.offset();
+	publish(instructions, heapBytes, callStack(stack, bp, program.size(), ip).size(), ip);
+}
+
+bool executor::Metrics::read(MetricsValues& out) const noexcept {
+	for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+		const uint32_t before = block->sequence.load(std::memory_order_acquire);
+		if (before & 1) continue;
+		std::memcpy(&out, &block->values, sizeof(out));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (block->sequence.load(std::memory_order_relaxed) == before) return true;
+	}
+	return false;
+}
+
+int executor::stat(const int pid, std::ostream& outstream) {
+	const std::unique_ptr<Metrics> metrics = Metrics::open(pid);
+	if (!metrics) {
+		outstream << IO_ERR "Process " << pid << " isn't publishing metrics. Run it with /execute --metrics" IO_NORM IO_END;
+		return 1;
+	}
+
+	MetricsValues values{};
+	if (!metrics->read(values)) {
+		outstream << IO_ERR "Process " << pid << " is publishing too fast to read" IO_NORM IO_END;
+		return 1;
+	}
+
+	const int64_t now = epochMs();
+	outstream << IO_MAIN "Process " << pid << ", running for " << (now - values.startedMs) / 1000 << "s, updated " << now - values.updatedMs << "ms ago\n" IO_NORM
+		<< std::fixed << std::setprecision(0)
+		<< "  instructions       " << values.instructions << "\n"
+		<< "  instructions/s     " << values.instructionsPerSecond << "\n"
+		<< "  heap bytes         " << values.heapBytes << "\n"
+		<< "  stack depth        " << values.stackFrames << " frames\n"
+		<< "  at                 " << values.label << (values.label[0] ? " " : "") << "BYTE" << values.ip << "\n"
+		<< IO_END;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include "executor.h"
+#include "../utils/bytecode.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Live Metrics
+
+	// What a running VM last published, as /stat shows it
+	struct MetricsValues {
+		// Counted in whole intervals, so up to one interval behind for each thread
+		uint64_t instructions;
+		// Over the last interval
+		double instructionsPerSecond;
+		// How far into the heap ALLOC has ever handed out, which counts freed blocks kept for reuse
+		uint64_t heapBytes;
+		// Frames, as the profilers count them, up to MAX_STACK_DEPTH
+		uint64_t stackFrames;
+		// Where the thread that published was, and the last label at or before it, or "" without symbols
+		bytecode::types::word_t ip;
+		char label[64];
+		// Milliseconds since the epoch, so another process can tell how old they are
+		int64_t startedMs;
+		int64_t updatedMs;
+	};
+
+	// Counters published to shared memory named after the process, for /stat to read without stopping it
+	// Only one of these can be published per process
+	class Metrics {
+	private:
+		// Laid out the same in every process that maps it
+		struct Block {
+			uint32_t magic;
+			uint32_t version;
+			// Odd while values is being written. Readers try again until it's the same even number before and after
+			std::atomic<uint32_t> sequence;
+			uint32_t padding;
+			MetricsValues values;
+		};
+
+		std::string name;
+		Block* block;
+		// The process that made it, and so takes the name away again. 0 for ones opened to be read
+		int owner;
+		// Labels to name ip by, from the assembler's --symbols
+		std::map<bytecode::types::word_t, std::string> symbols;
+		// What was published last, for the rate
+		uint64_t lastInstructions;
+		int64_t lastNs;
+		// The instructions threads have counted so far
+		std::atomic<uint64_t> retired;
+		// Held by whichever thread is publishing. The others skip their turn rather than wait
+		std::mutex publishing;
+
+		Metrics(std::string name, Block* const block, const int owner) noexcept;
+
+		void publish(const uint64_t instructions, const uint64_t heapBytes, const uint64_t stackFrames, const bytecode::types::word_t ip) noexcept;
+
+	public:
+		// Publishes for this process, or returns null if the shared memory can't be made. A process forked from this one
+		// leaves it alone
+		[[nodiscard]] static std::unique_ptr<Metrics> create(std::map<bytecode::types::word_t, std::string> symbols);
+		// Finds what process pid publishes, or returns null if it doesn't
+		[[nodiscard]] static std::unique_ptr<Metrics> open(const int pid);
+		~Metrics();
+
+		Metrics(const Metrics&) = delete;
+		Metrics& operator=(const Metrics&) = delete;
+
+		// A thread with BP at bp on stack has run another interval of instructions. Counts them, and publishes where the
+		// thread is now, unless another thread already is
+		void retire(const uint64_t interval, const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program,
+					const uint64_t heapBytes);
+		// Returns false if the values wouldn't stay still long enough to be read
+		bool read(MetricsValues& out) const noexcept;
+	};
+
+	// The id of this process, which names what it publishes
+	[[nodiscard]] int processId() noexcept;
+	// For /stat: prints what process pid last published
+	int stat(const int pid, std::ostream& outstream);
+}
\ No newline at end of file
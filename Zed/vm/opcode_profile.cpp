@@ -0,0 +1,29 @@
+#include "opcode_profile.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Opcode Profile
+
+executor::OpcodeProfile::Counter* executor::OpcodeProfile::newCounter() {
+	const std::lock_guard<std::mutex> lock(mutex);
+	counters.push_back(std::make_unique<Counter>());
+	return counters.back().get();
+}
+
+void executor::OpcodeProfile::clear() noexcept {
+	const std::lock_guard<std::mutex> lock(mutex);
+	counters.clear();
+}
+
+std::vector<executor::OpcodeProfile::Cost> executor::OpcodeProfile::total() {
+	std::vector<Cost> total(bytecode::opcodeCount);
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& counter : counters) {
+		for (int i = 0; i < bytecode::opcodeCount; i++) {
+			total[i].dispatches += counter->costs[i].dispatches;
+			total[i].samples += counter->costs[i].samples;
+			total[i].cycles += counter->costs[i].cycles;
+		}
+	}
+	return total;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include "executor.h"
+#include "../utils/bytecode.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Opcode Profile
+
+	// What the interpreter spends on each opcode, with FLAG_PROFILE_OPCODES. Every dispatch is counted, and one in
+	// OPCODE_SAMPLE_INTERVAL is timed, from reading its opcode to the end of its handler
+	class OpcodeProfile {
+	public:
+		// What was spent on one opcode
+		struct Cost {
+			uint64_t dispatches = 0;
+			// How many of the dispatches were timed, and the cycles they took between them
+			uint64_t samples = 0;
+			uint64_t cycles = 0;
+		};
+
+		// One thread's costs. Only that thread adds to them, so threads never contend
+		class Counter {
+		private:
+			Cost costs[bytecode::opcodeCount];
+			int untilSample = OPCODE_SAMPLE_INTERVAL;
+			// When the dispatch being timed started, or 0 if none is, and its opcode
+			uint64_t started = 0;
+			bytecode::types::opcode_t timing = 0;
+
+			// The time stamp counter. Nanoseconds instead, where there isn't one
+			static uint64_t cycles() noexcept {
+			#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+				return __rdtsc();
+			#else
+				return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+			#endif
+			}
+
+			friend class OpcodeProfile;
+
+		public:
+			// Counts a dispatch, and starts timing it if it's due
+			void dispatch(const bytecode::types::opcode_t opcode) noexcept {
+				if (opcode >= bytecode::opcodeCount) return;
+				costs[opcode].dispatches++;
+				if (--untilSample == 0) {
+					untilSample = OPCODE_SAMPLE_INTERVAL;
+					timing = opcode;
+					started = cycles();
+				}
+			}
+
+			// The handler of the last dispatch has finished. Handlers that return (like HALT) never get here, which only
+			// loses the odd sample
+			void finish() noexcept {
+				if (!started) return;
+				costs[timing].samples++;
+				costs[timing].cycles += cycles() - started;
+				started = 0;
+			}
+		};
+
+	private:
+		std::vector<std::unique_ptr<Counter>> counters;
+		std::mutex mutex;
+
+	public:
+		OpcodeProfile() = default;
+
+		OpcodeProfile(const OpcodeProfile&) = delete;
+		OpcodeProfile& operator=(const OpcodeProfile&) = delete;
+
+		// A zeroed counter for a thread to add to. Kept until the next clear
+		Counter* newCounter();
+		// Forgets every counter, which threads must no longer be using
+		void clear() noexcept;
+		// What every thread has spent on each opcode so far, by opcode. Only meaningful while no other threads are running
+		[[nodiscard]] std::vector<Cost> total();
+	};
+}
\ No newline at end of file
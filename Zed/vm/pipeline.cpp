@@ -0,0 +1,229 @@
+#include "pipeline.h"
+#include "vm.h"
+#include "channel.h"
+#include "../utils/io_utils.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Pipeline Functions
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	// A port of an isolate, and which end of its channel it's on
+	struct Binding {
+		int port;
+		bool sends;
+		std::shared_ptr<executor::Channel> channel;
+	};
+
+	// One isolate line of the topology, and what happened when it ran
+	struct Isolate {
+		int line;
+		std::string program;
+		std::shared_ptr<const bytecode::Image> image;
+		std::vector<Binding> bindings;
+
+		std::unique_ptr<executor::VM> vm;
+		bool failed;
+		std::string error;
+	};
+
+	// Parses "3>name" or "3<name"
+	Binding parseBinding(const std::string& str, const int line,
+						 const std::unordered_map<std::string, std::shared_ptr<executor::Channel>>& channels) {
+		using executor::ExecutorException;
+
+		const size_t split = str.find_first_of("<>");
+		if (split == std::string::npos || split == 0) {
+			throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, line, ("expected a port binding, not \"" + str + "\"").c_str());
+		}
+
+		Binding binding{};
+		try {
+			size_t used = 0;
+			binding.port = std::stoi(str.substr(0, split), &used);
+			if (used != split || binding.port < 0) throw std::invalid_argument(str);
+		} catch (const std::exception&) {
+			throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, line, ("invalid port in \"" + str + "\"").c_str());
+		}
+		binding.sends = str[split] == '>';
+
+		const auto it = channels.find(str.substr(split + 1));
+		if (it == channels.end()) {
+			throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, line, ("unknown channel \"" + str.substr(split + 1) + "\"").c_str());
+		}
+		binding.channel = it->second;
+		return binding;
+	}
+}
+
+int executor::pipeline(const char* const topologyPath, const ExecutorSettings& settings) {
+	using namespace executor;
+	using std::cout;
+
+	cout << IO_MAIN "Attempting to run pipeline \"" << topologyPath << "\"\n" IO_NORM;
+
+	std::fstream topology;
+	topology.open(topologyPath, std::ios::in);
+	if (!topology.is_open()) {
+		cout << IO_ERR "Could not open file \"" << topologyPath << "\"" IO_NORM IO_END;
+		return 1;
+	}
+
+	try {
+		const int out = executor::pipeline_(topology, settings, cout);
+		cout << IO_MAIN "Pipeline finished with code: " << out << IO_NORM IO_END;
+		return out;
+	} catch (const ExecutorException& e) {
+		cout << IO_ERR "Error in topology at LINE " << e.getLoc() << " : " << e.what() << IO_NORM IO_END;
+	} catch (const std::exception& e) {
+		cout << IO_ERR "An unknown error occurred while running the pipeline. This error is most likely an issue with the c++ executor code, not your code. Sorry. The provided error message is as follows:\n" << e.what() << IO_NORM IO_END;
+	}
+
+	return 1;
+}
+
+int executor::pipeline_(std::istream& topology, const ExecutorSettings& settings, std::ostream& stream) {
+	const bool isDebug = settings.flags.hasFlags(Flags::FLAG_DEBUG);
+
+	// Read the topology
+	std::unordered_map<std::string, std::shared_ptr<Channel>> channels;
+	std::unordered_map<std::string, std::shared_ptr<const bytecode::Image>> images;
+	std::vector<Isolate> isolates;
+	std::string line;
+	int lineNum = 0;
+	while (std::getline(topology, line)) {
+		lineNum++;
+
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == ';') continue;
+
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+
+		if (kind == "channel") {
+			std::string name;
+			if (!(fields >> std::quoted(name))) {
+				throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, "expected a channel name");
+			}
+			int capacity = DEFAULT_CHANNEL_CAPACITY;
+			if (!(fields >> capacity)) {
+				if (!fields.eof()) throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, "invalid channel capacity");
+				capacity = DEFAULT_CHANNEL_CAPACITY;
+			}
+			if (capacity <= 0) {
+				throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, "invalid channel capacity");
+			}
+			if (!channels.try_emplace(name, std::make_shared<Channel>(static_cast<size_t>(capacity))).second) {
+				throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, ("channel \"" + name + "\" already exists").c_str());
+			}
+		} else if (kind == "isolate") {
+			Isolate isolate{};
+			isolate.line = lineNum;
+			if (!(fields >> std::quoted(isolate.program))) {
+				throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, "expected a program");
+			}
+
+			// Load each distinct program once
+			const auto [it, added] = images.try_emplace(isolate.program);
+			if (added) {
+				std::fstream file;
+				file.open(isolate.program, std::ios::in | std::ios::binary);
+				if (!file.is_open()) {
+					throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, ("could not open file \"" + isolate.program + "\"").c_str());
+				}
+				it->second = std::make_shared<const bytecode::Image>(file);
+			}
+			isolate.image = it->second;
+
+			std::string str;
+			while (fields >> str) {
+				Binding binding = parseBinding(str, lineNum, channels);
+				for (const Binding& other : isolate.bindings) {
+					if (other.port == binding.port) {
+						throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, ("port " + std::to_string(binding.port) + " is bound twice").c_str());
+					}
+				}
+				isolate.bindings.push_back(std::move(binding));
+			}
+			isolates.push_back(std::move(isolate));
+		} else {
+			throw ExecutorException(ExecutorException::ErrorType::BAD_TOPOLOGY, lineNum, "expected \"channel\" or \"isolate\"");
+		}
+	}
+
+	// Wire everything up before anything runs, so no channel looks closed just because its sender hasn't started
+	for (Isolate& isolate : isolates) {
+		isolate.vm = std::make_unique<VM>(settings);
+		isolate.vm->load(isolate.image);
+		for (const Binding& binding : isolate.bindings) {
+			isolate.vm->bindPort(binding.port, binding.channel);
+			if (binding.sends) {
+				binding.channel->addSender();
+			} else {
+				binding.channel->addReceiver();
+			}
+		}
+	}
+
+	if (isDebug) {
+		stream << IO_DEBUG "Wired " << isolates.size() << " isolates to " << channels.size() << " channels" IO_NORM "\n";
+	}
+
+	// Run every isolate on its own thread
+	const Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	threads.reserve(isolates.size());
+	for (Isolate& isolate : isolates) {
+		threads.emplace_back([&isolate, &channels] {
+			try {
+				isolate.vm->run();
+			} catch (const ExecutorException& e) {
+				isolate.failed = true;
+				isolate.error = "Error during execution at BYTE" + std::to_string(e.getLoc()) + " : " + e.what();
+			} catch (const std::exception& e) {
+				isolate.failed = true;
+				isolate.error = e.what();
+			}
+
+			// A failure takes the whole pipeline down, rather than leaving the rest blocked on it
+			if (isolate.failed) {
+				for (const auto& [name, channel] : channels) {
+					channel->break_();
+				}
+			}
+			for (const Binding& binding : isolate.bindings) {
+				if (binding.sends) {
+					binding.channel->removeSender();
+				} else {
+					binding.channel->removeReceiver();
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	const double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	// Report
+	int failed = 0;
+	for (const Isolate& isolate : isolates) {
+		if (isolate.failed) {
+			failed++;
+			stream << IO_WARN "Isolate on LINE " << isolate.line << " (" << isolate.program << ") failed : " << isolate.error << IO_NORM "\n";
+		}
+	}
+
+	stream << IO_INFO "Ran " << isolates.size() << " isolates (" << failed << " failed) in " << totalMs << " ms" IO_NORM "\n";
+	return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+#include "executor.h"
+#include <iostream>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Constants?
+
+	// Default capacity of a channel, in words
+	constexpr int DEFAULT_CHANNEL_CAPACITY = 1024;
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Pipeline Functions
+
+	// Runs a topology of isolates: separate VMs, each on its own thread, that only talk through channels
+	// Each line of the topology is one of
+	//     channel [name] [capacity]
+	//     isolate [.eze file] [port]>[channel] [port]<[channel] ...
+	// where > binds a port the isolate sends on, and < one it receives on. Lines starting with ';' are comments
+	// A channel closes once every isolate sending on it has finished, and if any isolate fails, every channel breaks
+	int pipeline(const char* const topologyPath, const ExecutorSettings& settings);
+	int pipeline_(std::istream& topology, const ExecutorSettings& settings, std::ostream& stream);
+}
\ No newline at end of file
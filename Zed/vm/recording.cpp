@@ -0,0 +1,61 @@
+#include "recording.h"
+#include <cstring>
+
+namespace {
+	constexpr char RECORDING_MAGIC[8] = { 'Z', 'E', 'D', 'R', 'E', 'C', 'R', 1 };
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Record and Replay
+
+executor::Recording::Recording(std::unique_ptr<std::ostream> out) noexcept : out(std::move(out)) {}
+
+executor::Recording::Recording(std::unique_ptr<std::istream> in) noexcept : in(std::move(in)) {}
+
+std::unique_ptr<executor::Recording> executor::Recording::record(std::unique_ptr<std::ostream> out, const std::string& snapshot) {
+	const uint64_t length = snapshot.size();
+	out->write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	out->write(reinterpret_cast<const char*>(&length), sizeof(length));
+	out->write(snapshot.data(), static_cast<std::streamsize>(length));
+	if (!*out) return nullptr;
+	return std::unique_ptr<Recording>(new Recording(std::move(out)));
+}
+
+std::unique_ptr<executor::Recording> executor::Recording::replay(std::unique_ptr<std::istream> in, std::string& snapshot) {
+	char magic[sizeof(RECORDING_MAGIC)]{};
+	uint64_t length = 0;
+	in->read(magic, sizeof(magic));
+	in->read(reinterpret_cast<char*>(&length), sizeof(length));
+	if (!*in || std::memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 || length > UINT32_MAX) return nullptr;
+
+	snapshot.assign(static_cast<size_t>(length), '\0');
+	in->read(snapshot.data(), static_cast<std::streamsize>(length));
+	if (!*in) return nullptr;
+	return std::unique_ptr<Recording>(new Recording(std::move(in)));
+}
+
+bool executor::Recording::isReplaying() const noexcept {
+	return in != nullptr;
+}
+
+void executor::Recording::expect(const Event kind, const int loc) {
+	char found;
+	if (!in->get(found)) {
+		throw ExecutorException(ExecutorException::ErrorType::REPLAY_DIVERGED, loc, "the recording ends here");
+	}
+	if (static_cast<Event>(found) != kind) diverged(loc);
+}
+
+void executor::Recording::write(const Event kind, const char* const bytes, const size_t size) {
+	out->put(static_cast<char>(kind));
+	out->write(bytes, static_cast<std::streamsize>(size));
+}
+
+void executor::Recording::read(char* const bytes, const size_t size, const int loc) {
+	in->read(bytes, static_cast<std::streamsize>(size));
+	if (!*in) throw ExecutorException(ExecutorException::ErrorType::REPLAY_DIVERGED, loc, "the recording ends here");
+}
+
+void executor::Recording::diverged(const int loc) {
+	throw ExecutorException(ExecutorException::ErrorType::REPLAY_DIVERGED, loc);
+}
\ No newline at end of file
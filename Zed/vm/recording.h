@@ -0,0 +1,94 @@
+#pragma once
+#include "executor.h"
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Record and Replay
+
+	// Everything a run took from outside the VM, in the order it took it, so that the run can be repeated exactly
+	// A recording starts with a snapshot from before the run, which puts the heap back at the same address on replay,
+	// so ALLOC hands out the same blocks again. Their addresses are still kept, to catch a replay that has gone another way
+	// Each event is its kind in a byte, then its value in the host's byte order. Threads share one order of events, so a
+	// program whose threads race each other for input can't be replayed
+	class Recording {
+	public:
+		enum class Event : uint8_t {
+			READ_C,
+			READ_STR,
+			TIME,
+			CLOCK_NS,
+			ALLOC
+		};
+
+	private:
+		// One of these, depending on which way it goes
+		std::unique_ptr<std::ostream> out;
+		std::unique_ptr<std::istream> in;
+		std::mutex mutex;
+
+		explicit Recording(std::unique_ptr<std::ostream> out) noexcept;
+		explicit Recording(std::unique_ptr<std::istream> in) noexcept;
+
+		// Checks that the next event is kind, throwing if the replay has gone another way or the recording has ended
+		void expect(const Event kind, const int loc);
+		void write(const Event kind, const char* const bytes, const size_t size);
+		void read(char* const bytes, const size_t size, const int loc);
+		// Throws, for a replay that has gone another way
+		[[noreturn]] static void diverged(const int loc);
+
+	public:
+		// Starts recording a run, which has to be exactly as the snapshot left it. Returns null if out has failed
+		[[nodiscard]] static std::unique_ptr<Recording> record(std::unique_ptr<std::ostream> out, const std::string& snapshot);
+		// Opens a recording, and gives back its snapshot, which has to be restored before it's replayed
+		// Returns null if in isn't a recording
+		[[nodiscard]] static std::unique_ptr<Recording> replay(std::unique_ptr<std::istream> in, std::string& snapshot);
+
+		Recording(const Recording&) = delete;
+		Recording& operator=(const Recording&) = delete;
+
+		[[nodiscard]] bool isReplaying() const noexcept;
+
+		// Takes a value from outside: while recording, from take() and writing it down, and while replaying, from the recording
+		template<typename T, typename F>
+		T pass(const Event kind, const int loc, F&& take) {
+			const std::lock_guard<std::mutex> lock(mutex);
+			T value;
+			if (in) {
+				expect(kind, loc);
+				read(reinterpret_cast<char*>(&value), sizeof(T), loc);
+			} else {
+				value = take();
+				write(kind, reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+			return value;
+		}
+		// The same for a line, which take() reads into line
+		template<typename F>
+		void passLine(const Event kind, std::string& line, const int loc, F&& take) {
+			const std::lock_guard<std::mutex> lock(mutex);
+			uint32_t length;
+			if (in) {
+				expect(kind, loc);
+				read(reinterpret_cast<char*>(&length), sizeof(length), loc);
+				line.resize(length);
+				read(line.data(), length, loc);
+			} else {
+				take();
+				length = static_cast<uint32_t>(line.size());
+				write(kind, reinterpret_cast<const char*>(&length), sizeof(length));
+				out->write(line.data(), length);
+			}
+		}
+		// Writes down a value the VM came up with itself, or while replaying checks that it came up with the same one
+		template<typename T>
+		void check(const Event kind, const T value, const int loc) {
+			if (pass<T>(kind, loc, [value] { return value; }) != value) diverged(loc);
+		}
+	};
+}
\ No newline at end of file
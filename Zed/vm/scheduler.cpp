@@ -0,0 +1,234 @@
+#include "scheduler.h"
+#include "executor.h"
+#include "../utils/vmem.h"
+#include <algorithm>
+#include <iterator>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Task Stacks
+
+namespace {
+	constexpr bytecode::types::word_t STACK_CANARY = 0x5AFE57AC;
+}
+
+executor::StackPool::StackPool(const int stackSize, Stack& owner) : owner(owner), stackSize(vmem::roundUp(static_cast<size_t>(stackSize))) {}
+
+executor::StackPool::~StackPool() {
+	const size_t chunkSize = (stackSize + vmem::pageSize()) * STACKS_PER_CHUNK;
+	for (char* const chunk : chunks) {
+		owner.removeGuarded(chunk);
+		vmem::release(chunk, chunkSize);
+	}
+}
+
+size_t executor::StackPool::getStackSize() const noexcept {
+	return stackSize;
+}
+
+char* executor::StackPool::get() {
+	if (spare.empty()) {
+		// Each stack, then the guard page after it, which is left reserved and never committed
+		const size_t stride = stackSize + vmem::pageSize();
+		char* const chunk = vmem::reserve(stride * STACKS_PER_CHUNK);
+		if (!chunk) throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, 0, "Could not reserve task stacks");
+		for (int i = 0; i < STACKS_PER_CHUNK; i++) {
+			if (!vmem::commit(chunk + stride * i, stackSize)) {
+				vmem::release(chunk, stride * STACKS_PER_CHUNK);
+				throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, 0, "Could not commit task stacks");
+			}
+		}
+
+		chunks.push_back(chunk);
+		owner.addGuarded(chunk, stride * STACKS_PER_CHUNK);
+		for (int i = STACKS_PER_CHUNK - 1; i >= 0; i--) {
+			spare.push_back(chunk + stride * i);
+		}
+	}
+
+	char* const stack = spare.back();
+	spare.pop_back();
+	*reinterpret_cast<bytecode::types::word_t*>(stack + stackSize - sizeof(bytecode::types::word_t)) = STACK_CANARY;
+	return stack;
+}
+
+void executor::StackPool::put(char* const stack) noexcept {
+	spare.push_back(stack);
+}
+
+bool executor::StackPool::intact(const char* const stack) const noexcept {
+	return *reinterpret_cast<const bytecode::types::word_t*>(stack + stackSize - sizeof(bytecode::types::word_t)) == STACK_CANARY;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The Scheduler
+
+executor::Scheduler::Scheduler(const int stackSize, Stack& owner) : owner(owner), stacks(stackSize, owner) {
+	// The thread that made the scheduler is the first task
+	slots.emplace_back();
+	slots.back().task = std::make_unique<Task>();
+	current = slots.back().task.get();
+	current->handle = 1;
+}
+
+executor::Scheduler::~Scheduler() {
+	owner.setFrames(nullptr, 0);
+}
+
+void executor::Scheduler::save(const bytecode::Program& program, const bytecode::types::WordVal* const wordReg,
+							   const bytecode::types::ByteVal* const byteReg) noexcept {
+	std::copy_n(wordReg, bytecode::reg::Count, current->wordReg);
+	std::copy_n(byteReg, bytecode::reg::Count, current->byteReg);
+	current->ip = program.offset();
+}
+
+void executor::Scheduler::runNext(bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg) {
+	if (runQueue.empty()) {
+		throw ExecutorException(ExecutorException::ErrorType::DEADLOCK, program.offset());
+	}
+
+	current = runQueue.front();
+	runQueue.pop_front();
+
+	std::copy_n(current->wordReg, bytecode::reg::Count, wordReg);
+	std::copy_n(current->byteReg, bytecode::reg::Count, byteReg);
+	program.goto_(current->ip);
+	// So the profilers walk the task's own frames
+	owner.setFrames(current->stack, stacks.getStackSize());
+}
+
+void executor::Scheduler::checkStack(const int loc) const {
+	if (current->stack && !stacks.intact(current->stack)) {
+		throw ExecutorException(ExecutorException::ErrorType::STACK_OVERFLOW, loc, "in a task");
+	}
+}
+
+bytecode::types::word_t executor::Scheduler::spawn(const bytecode::Program& program, const bytecode::types::word_t entry,
+												   const bytecode::types::word_t arg) {
+	using namespace bytecode;
+
+	char* const stack = stacks.get();
+
+	types::word_t handle;
+	if (freeHandles.empty()) {
+		slots.emplace_back();
+		handle = static_cast<types::word_t>(slots.size());
+	} else {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+
+	std::unique_ptr<Task>& slot = slots[handle - 1].task;
+	if (spareTasks.empty()) {
+		slot = std::make_unique<Task>();
+	} else {
+		slot = std::move(spareTasks.back());
+		spareTasks.pop_back();
+	}
+
+	Task& task = *slot;
+	task.handle = handle;
+	task.stack = stack;
+
+	// Cleared as for a new thread, since a reused task still has the registers it finished with
+	std::fill(std::begin(task.wordReg), std::end(task.wordReg), types::WordVal{});
+	std::fill(std::begin(task.byteReg), std::end(task.byteReg), types::ByteVal{});
+
+	// Special registers
+	task.wordReg[reg::BP].word = reinterpret_cast<types::word_t>(task.stack);
+	task.wordReg[reg::RP].word = reinterpret_cast<types::word_t>(task.stack);
+	task.wordReg[reg::PP].word = reinterpret_cast<types::word_t>(program.begin());
+	task.ip = entry;
+
+	// A frame as if called: the old BP, then a return IP just past the end of the program (so returning ends the task),
+	// then the argument
+	types::word_t* const frame = reinterpret_cast<types::word_t*>(task.stack);
+	frame[0] = task.wordReg[reg::BP].word;
+	frame[1] = program.size();
+	frame[2] = arg;
+
+	runQueue.push_back(&task);
+	return task.handle;
+}
+
+void executor::Scheduler::yield(bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg) {
+	if (runQueue.empty()) return;
+
+	checkStack(program.offset());
+	save(program, wordReg, byteReg);
+	runQueue.push_back(current);
+	runNext(program, wordReg, byteReg);
+}
+
+void executor::Scheduler::wait(const bytecode::types::reg_t dst, const bytecode::types::word_t handle,
+							   bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg) {
+	Slot* const slot = handle > 0 && static_cast<size_t>(handle) <= slots.size() ? &slots[handle - 1] : nullptr;
+	if (!slot || slot->task.get() == current || (!slot->task && !slot->finished)) {
+		throw ExecutorException(ExecutorException::ErrorType::BAD_TASK, program.offset());
+	}
+
+	if (slot->finished) {
+		wordReg[dst].word = slot->result;
+		slot->finished = false;
+		freeHandles.push_back(handle);
+		return;
+	}
+
+	checkStack(program.offset());
+	save(program, wordReg, byteReg);
+	current->waitReg = dst;
+	slot->task->waiters.push_back(current);
+	runNext(program, wordReg, byteReg);
+}
+
+bool executor::Scheduler::running() const noexcept {
+	return std::any_of(std::next(slots.begin()), slots.end(), [](const Slot& slot) { return slot.task != nullptr; });
+}
+
+bool executor::Scheduler::finish(bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg) {
+	// Again if the next task has left the program too, which only the first one can have
+	do {
+		if (!current->stack) {
+			// The first task takes the whole thread with it, so it lets the rest run first, handing its result to anything
+			// waiting on it, and comes back here whenever it's next up
+			for (Task* const waiter : current->waiters) {
+				waiter->wordReg[waiter->waitReg].word = wordReg[bytecode::reg::W0].word;
+				runQueue.push_back(waiter);
+			}
+			current->waiters.clear();
+
+			if (runQueue.empty()) {
+				// Anything else left is waiting on something that will never finish
+				if (running()) throw ExecutorException(ExecutorException::ErrorType::DEADLOCK, program.offset());
+				return false;
+			}
+			save(program, wordReg, byteReg);
+			runQueue.push_back(current);
+			runNext(program, wordReg, byteReg);
+			continue;
+		}
+
+		checkStack(program.offset());
+		const bytecode::types::word_t result = wordReg[bytecode::reg::W0].word;
+		stacks.put(current->stack);
+		current->stack = nullptr;
+
+		for (Task* const waiter : current->waiters) {
+			waiter->wordReg[waiter->waitReg].word = result;
+			runQueue.push_back(waiter);
+		}
+
+		// Anything waiting has its result, so nothing else can ask for it. Otherwise the slot keeps it for the first wait
+		Slot& slot = slots[current->handle - 1];
+		if (current->waiters.empty()) {
+			slot.finished = true;
+			slot.result = result;
+		} else {
+			freeHandles.push_back(current->handle);
+		}
+		current->waiters.clear();
+		spareTasks.push_back(std::move(slot.task));
+
+		runNext(program, wordReg, byteReg);
+	} while (!program.inBounds());
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+#include "executor.h"
+#include "../utils/bytecode.h"
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Task Stacks
+
+	// Hands out small fixed-size stacks for tasks, carved from larger chunks and reused once a task has finished
+	// Each stack is followed by a guard page, which the owning thread's stack counts as its own, so running off the end is
+	// an overflow. The last word of each stack is also a canary, checked whenever its task is switched out, for frames
+	// that skip right over the guard page
+	class StackPool {
+	private:
+		static constexpr int STACKS_PER_CHUNK = 64;
+
+		Stack& owner;
+		// Whole pages
+		const size_t stackSize;
+		std::vector<char*> chunks;
+		std::vector<char*> spare;
+
+	public:
+		StackPool(const int stackSize, Stack& owner);
+		~StackPool();
+
+		StackPool(const StackPool&) = delete;
+		StackPool& operator=(const StackPool&) = delete;
+
+		[[nodiscard]] size_t getStackSize() const noexcept;
+		[[nodiscard]] char* get();
+		void put(char* const stack) noexcept;
+		// Whether a stack's canary is still there
+		[[nodiscard]] bool intact(const char* const stack) const noexcept;
+	};
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// The Scheduler
+
+	// Runs cooperative tasks (green threads) on one guest thread, which is itself the first task
+	// The running task's registers stay in the thread's register file, so switching is just swapping them with the next task's
+	class Scheduler {
+	private:
+		struct Task {
+			bytecode::types::WordVal wordReg[bytecode::reg::Count];
+			bytecode::types::ByteVal byteReg[bytecode::reg::Count];
+			bytecode::types::word_t ip;
+			// From the pool, or null for the first task, which uses the thread's own stack
+			char* stack;
+
+			bytecode::types::word_t handle;
+			// Tasks blocked in TASK_WAIT on this one
+			std::vector<Task*> waiters;
+			// Where this task wants the result of what it's waiting on
+			bytecode::types::reg_t waitReg;
+		};
+
+		// What a handle refers to: a task that hasn't finished, the result of one that has and hasn't been waited on yet,
+		// or nothing, once it has been waited on
+		struct Slot {
+			std::unique_ptr<Task> task;
+			bool finished = false;
+			bytecode::types::word_t result = 0;
+		};
+
+		// The thread's stack, told whose frames are running
+		Stack& owner;
+		StackPool stacks;
+		// By handle, less one
+		std::vector<Slot> slots;
+		// Handles whose slots are empty, for spawn to reuse
+		std::vector<bytecode::types::word_t> freeHandles;
+		// Tasks that have finished, kept to be reused, since a finished task only needs its slot to keep its result
+		std::vector<std::unique_ptr<Task>> spareTasks;
+		std::deque<Task*> runQueue;
+		Task* current;
+
+		// Copies the running task's state out of the thread into current
+		void save(const bytecode::Program& program, const bytecode::types::WordVal* const wordReg, const bytecode::types::ByteVal* const byteReg) noexcept;
+		// Makes the next task in the run queue current, and copies its state into the thread. Throws if there isn't one
+		void runNext(bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg);
+		// Throws if the current task has overrun its stack
+		void checkStack(const int loc) const;
+
+	public:
+		// owner is the stack of the thread the tasks run on
+		Scheduler(const int stackSize, Stack& owner);
+		~Scheduler();
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		// Queues a task at entry, called with arg as if by the usual calling convention, and returns its handle
+		// A handle can be given out again once it has been waited on
+		bytecode::types::word_t spawn(const bytecode::Program& program, const bytecode::types::word_t entry, const bytecode::types::word_t arg);
+		// Moves the current task to the back of the run queue and runs the one at the front
+		void yield(bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg);
+		// Puts a task's result (its W0) in dst once it has finished, running other tasks in the meantime
+		// Every wait that starts before the task finishes gets the result, but only the first one after it does
+		void wait(const bytecode::types::reg_t dst, const bytecode::types::word_t handle,
+				  bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg);
+		// Whether any task but the first is still to finish. Results nothing has waited for yet don't count, so a snapshot loses them
+		[[nodiscard]] bool running() const noexcept;
+		// Ends the current task, once it has returned from its first frame, and runs the next
+		// The first task waits for the rest to finish, and then returns false, meaning the whole thread is done
+		bool finish(bytecode::Program& program, bytecode::types::WordVal* const wordReg, bytecode::types::ByteVal* const byteReg);
+	};
+}
\ No newline at end of file
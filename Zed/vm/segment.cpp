@@ -0,0 +1,81 @@
+#include "segment.h"
+#include "../utils/vmem.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+namespace {
+	constexpr uint32_t SEGMENT_MAGIC = 0x4745535A;
+	constexpr uint32_t SEGMENT_VERSION = 1;
+	// Room for the root word, keeping blocks 8-byte aligned
+	constexpr size_t ROOT_SIZE = 8;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Persistent Segments
+
+executor::Segment::Segment(std::string path, char* const base, const size_t size, const bool moved) noexcept
+	: path(std::move(path)), base(base), size(size), moved(moved) {}
+
+std::unique_ptr<executor::Segment> executor::Segment::open(const std::string& path, const size_t size) {
+	// Read the header first, to find out where the segment wants to go
+	Header header{};
+	bool existed = false;
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (file) {
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+			existed = file.gcount() > 0;
+			if (existed && (!file || header.magic != SEGMENT_MAGIC || header.version != SEGMENT_VERSION)) return nullptr;
+		}
+	}
+
+	char* const want = existed ? reinterpret_cast<char*>(static_cast<uintptr_t>(header.address)) : nullptr;
+	size_t mapped = std::max(size, sizeof(Header) + ROOT_SIZE);
+	char* const base = vmem::mapFile(path.c_str(), mapped, want);
+	if (!base) return nullptr;
+
+	Header& h = *reinterpret_cast<Header*>(base);
+	if (!existed) {
+		h.magic = SEGMENT_MAGIC;
+		h.version = SEGMENT_VERSION;
+		h.address = reinterpret_cast<uintptr_t>(base);
+		h.top = sizeof(Header) + ROOT_SIZE;
+	}
+
+	return std::unique_ptr<Segment>(new Segment(path, base, mapped, existed && base != want));
+}
+
+executor::Segment::~Segment() {
+	flush();
+	vmem::unmapFile(base, size);
+}
+
+const std::string& executor::Segment::getPath() const noexcept {
+	return path;
+}
+
+char* executor::Segment::root() const noexcept {
+	return base + sizeof(Header);
+}
+
+bool executor::Segment::isMoved() const noexcept {
+	return moved;
+}
+
+char* executor::Segment::allocate(const size_t bytes) noexcept {
+	if (bytes > size) return nullptr;
+	const uint64_t total = (bytes + 7) / 8 * 8;
+
+	std::atomic_ref<uint64_t> top(reinterpret_cast<Header*>(base)->top);
+	uint64_t at = top.load();
+	do {
+		if (at + total > size) return nullptr;
+	} while (!top.compare_exchange_weak(at, at + total));
+
+	return base + at;
+}
+
+void executor::Segment::flush() noexcept {
+	vmem::flushFile(base, size);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Persistent Segments
+
+	// A file mapped into memory for POPEN, so that what a program builds in it is still there the next time it runs
+	// The file starts with a header, then a root word for the program to find its data from, then everything PALLOC
+	// has handed out. There is no freeing, since it's meant for building something once and reading it many times
+	class Segment {
+	private:
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			// Where the segment was first mapped. It goes back there if it can, so pointers stored in it stay valid
+			uint64_t address;
+			// Offset of the next PALLOC
+			uint64_t top;
+		};
+
+		std::string path;
+		char* base;
+		size_t size;
+		bool moved;
+
+		Segment(std::string path, char* const base, const size_t size, const bool moved) noexcept;
+
+	public:
+		// Maps the file at path, creating it with room for at least size bytes, or growing it to that
+		// Returns null if it can't be mapped, or the file isn't a segment
+		[[nodiscard]] static std::unique_ptr<Segment> open(const std::string& path, const size_t size);
+		~Segment();
+
+		Segment(const Segment&) = delete;
+		Segment& operator=(const Segment&) = delete;
+
+		[[nodiscard]] const std::string& getPath() const noexcept;
+		// Where the root word is. What POPEN hands back, and what PALLOC takes to say which segment to use
+		[[nodiscard]] char* root() const noexcept;
+		// Whether the segment couldn't go back where it was first mapped, so pointers stored in it are wrong
+		[[nodiscard]] bool isMoved() const noexcept;
+
+		// Returns nullptr when the segment is full. Safe to call from any thread, or from another process sharing the file
+		[[nodiscard]] char* allocate(const size_t bytes) noexcept;
+		// Writes everything back to the file
+		void flush() noexcept;
+	};
+}
\ No newline at end of file
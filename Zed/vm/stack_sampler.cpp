@@ -0,0 +1,53 @@
+#include "stack_sampler.h"
+#include "vm.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Call Stacks
+
+std::vector<bytecode::types::word_t> executor::callStack(const Stack& stack, const bytecode::types::word_t bp, const int programSize,
+														 const bytecode::types::word_t ip) {
+	using namespace bytecode::types;
+
+	std::vector<word_t> frames{ ip };
+
+	// Only what can be read as it is, so a bad BP can't fault anything in. In a task, that's the task's own stack
+	const auto [stackBegin, stackEnd] = stack.getFrames();
+	const char* frame = VM::memory(bp);
+	while (frames.size() < MAX_STACK_DEPTH && frame >= stackBegin && frame + 2 * sizeof(word_t) <= stackEnd) {
+		const word_t* const slots = reinterpret_cast<const word_t*>(frame);
+		// Returning past the end of the program is how PARFOR chunks and threads finish, so that's the bottom too
+		if (slots[1] <= 0 || slots[1] >= programSize) break;
+		frames.push_back(slots[1] - 1);
+
+		// The first frame saves its own BP
+		const char* const next = VM::memory(slots[0]);
+		if (next == frame) break;
+		frame = next;
+	}
+	return frames;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Stack Sampling
+
+executor::StackSampler::StackSampler() noexcept : due(false) {}
+
+void executor::StackSampler::take(const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program) {
+	const std::vector<bytecode::types::word_t> frames = callStack(stack, bp, program.size(), program.offset());
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	samples[frames]++;
+}
+
+void executor::StackSampler::request() noexcept {
+	due.store(true, std::memory_order_relaxed);
+}
+
+void executor::StackSampler::clear() noexcept {
+	const std::lock_guard<std::mutex> lock(mutex);
+	samples.clear();
+}
+
+const std::map<std::vector<bytecode::types::word_t>, uint64_t>& executor::StackSampler::getSamples() const noexcept {
+	return samples;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include "executor.h"
+#include "../utils/bytecode.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Call Stacks
+
+	// Follows the saved BPs and return IPs down a stack, as laid out by fibonacci_recursive.azm, from an instruction at ip
+	// with BP at bp. Gives the offsets of ip and then of each return address less one, so every frame is named by its call
+	// Stops after MAX_STACK_DEPTH frames, or at a return address outside a program of programSize bytes
+	[[nodiscard]] std::vector<bytecode::types::word_t> callStack(const Stack& stack, const bytecode::types::word_t bp,
+																 const int programSize, const bytecode::types::word_t ip);
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Stack Sampling
+
+	// How many times each call stack was caught running, with a sample rate. Something outside asks for a sample, and the
+	// next instruction any thread runs takes it
+	class StackSampler {
+	private:
+		// Set by request, and cleared by whichever thread takes the sample
+		std::atomic<bool> due;
+		// As found by callStack
+		std::map<std::vector<bytecode::types::word_t>, uint64_t> samples;
+		std::mutex mutex;
+
+		void take(const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program);
+
+	public:
+		StackSampler() noexcept;
+
+		StackSampler(const StackSampler&) = delete;
+		StackSampler& operator=(const StackSampler&) = delete;
+
+		// Asks for the next instruction any thread runs to take a sample. Safe to call from a signal handler
+		void request() noexcept;
+		// Takes a sample of a thread about to run its next instruction, if one is due
+		void poll(const Stack& stack, const bytecode::types::word_t bp, const bytecode::Program& program) {
+			if (due.load(std::memory_order_relaxed) && due.exchange(false)) take(stack, bp, program);
+		}
+		void clear() noexcept;
+
+		// Only meaningful while no other threads are running
+		[[nodiscard]] const std::map<std::vector<bytecode::types::word_t>, uint64_t>& getSamples() const noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,2301 @@
+#include "vm.h"
+#include "scheduler.h"
+#include "intrinsics.h"
+#include "../utils/thread_pool.h"
+#include "../utils/vmem.h"
+#include "../utils/io_utils.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <exception>
+#include <ctime>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <utility>
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Execution Limits
+
+namespace executor {
+	// Enforces --max-instructions and --timeout-ms, lets spawned threads be told to stop, and says when to checkpoint
+	// Fuel is only spent at backward branches (the number of instructions jumped back over) and register jumps (one),
+	// since every loop has to pass through one of those. Straight-line code doesn't pay anything
+	class Meter {
+	private:
+		const int64_t maxInstructions;
+		const bool hasTimeout;
+		const std::chrono::milliseconds timeout;
+		// Set by start, so the clocks only run once the thread does
+		bool started;
+		std::chrono::steady_clock::time_point deadline;
+		// Checked along with the clock, if there is one
+		const std::atomic<bool>* const stop;
+		// Called every checkpointMs with the offset to carry on from, which is the target of the jump being taken
+		const std::function<void(int)> checkpoint;
+		const std::chrono::milliseconds checkpointEvery;
+		std::chrono::steady_clock::time_point nextCheckpoint;
+
+		// Fuel that can be spent before the limits need looking at again
+		int64_t budget;
+		// The size of the current budget
+		int64_t granted;
+		// Fuel spent in all previous budgets
+		int64_t spent;
+
+		// The cost of each backward branch, indexed by the offset just after it. Zero until it has been worked out
+		std::vector<int32_t> branchCosts;
+
+		// Counts the instructions from a branch target up to (and including) the branch
+		static int32_t countInstructions(const bytecode::Program& program, const int from, const int to) noexcept {
+			using namespace bytecode;
+
+			const char* pos = program.begin() + from;
+			const char* const end = program.begin() + to;
+			int32_t count = 0;
+
+			while (pos < end) {
+				const auto opcode = static_cast<types::opcode_t>(*pos++);
+				count++;
+				if (opcode >= Opcode::ValidCount) break;
+
+				for (const int arg : opcodeArgs[opcode]) {
+					switch (static_cast<OpcodeArgType>(arg)) {
+						case OpcodeArgType::ARG_WORD_REG:
+						case OpcodeArgType::ARG_BYTE_REG:
+							pos += sizeof(types::reg_t);
+							break;
+						case OpcodeArgType::ARG_WORD:
+						case OpcodeArgType::ARG_NATIVE:
+							pos += sizeof(types::word_t);
+							break;
+						case OpcodeArgType::ARG_BYTE:
+							pos += sizeof(types::byte_t);
+							break;
+						default:
+							break;
+					}
+				}
+			}
+
+			return count;
+		}
+
+		// Tallies the fuel used, throws if a limit has been hit, checkpoints if it's time, and hands out a new budget
+		void refuel(const int loc, const int resume) {
+			using namespace executor;
+
+			spent += granted - budget;
+
+			if (maxInstructions && spent >= maxInstructions) {
+				throw ExecutorException(ExecutorException::ErrorType::INSTRUCTION_LIMIT, loc,
+										("stopped after " + std::to_string(spent) + " instructions").c_str());
+			}
+			if (hasTimeout && started && std::chrono::steady_clock::now() >= deadline) {
+				throw ExecutorException(ExecutorException::ErrorType::TIMEOUT, loc,
+										("stopped after " + std::to_string(spent) + " instructions").c_str());
+			}
+			if (stop && stop->load(std::memory_order_relaxed)) {
+				throw ExecutorException(ExecutorException::ErrorType::THREAD_STOPPED, loc);
+			}
+			if (checkpoint && started && std::chrono::steady_clock::now() >= nextCheckpoint) {
+				checkpoint(resume);
+				// From when it finished, so that a slow checkpoint can't take up all the time
+				nextCheckpoint = std::chrono::steady_clock::now() + checkpointEvery;
+			}
+
+			granted = hasTimeout || stop || checkpoint ? CLOCK_CHECK_INTERVAL : INT64_MAX;
+			if (maxInstructions && maxInstructions - spent < granted) granted = maxInstructions - spent;
+			budget = granted;
+		}
+
+	public:
+		Meter(const bytecode::Program& program, const executor::ExecutorSettings& settings, const std::atomic<bool>* const stop,
+			  std::function<void(int)> checkpoint = nullptr)
+			: maxInstructions(settings.maxInstructions), hasTimeout(settings.timeoutMs > 0), timeout(settings.timeoutMs),
+			started(false), stop(stop), checkpoint(std::move(checkpoint)), checkpointEvery(settings.checkpointMs),
+			budget(0), granted(0), spent(0), branchCosts(static_cast<size_t>(program.size()) + 1, 0) {
+			refuel(0, 0);
+		}
+
+		// Starts the timeout and checkpoint clocks, the first time the thread runs. Running it again carries on with them
+		void start() noexcept {
+			if (started) return;
+			started = true;
+			const auto now = std::chrono::steady_clock::now();
+			deadline = now + timeout;
+			nextCheckpoint = now + checkpointEvery;
+		}
+
+		// Spends fuel for a jump taken from just before `from` to `to`
+		void branch(const bytecode::Program& program, const int from, const int to) {
+			if (to >= from) return;
+
+			int32_t cost = 1;
+			if (to >= 0 && static_cast<size_t>(from) < branchCosts.size()) {
+				int32_t& cached = branchCosts[from];
+				if (!cached) cached = countInstructions(program, to, from);
+				cost = cached;
+			}
+
+			budget -= cost;
+			if (budget < 0) refuel(from, to);
+		}
+
+		// Spends fuel for a register jump from just before `from` to `to`
+		void jump(const int from, const int to) {
+			if (--budget < 0) refuel(from, to);
+		}
+	};
+}
+
+namespace {
+	// Whether a program has an INSTR_COUNT, which needs the instrumented loop to count what it runs
+	bool countsInstructions(const bytecode::Program& program) noexcept {
+		using namespace bytecode;
+
+		const char* pos = program.begin() + *reinterpret_cast<const types::word_t*>(program.begin() + FIRST_INSTR_ADDR_LOCATION);
+		const char* const end = program.begin() + program.size();
+		while (pos >= program.begin() && pos < end) {
+			const auto opcode = static_cast<types::opcode_t>(*pos);
+			if (opcode == Opcode::INSTR_COUNT) return true;
+
+			const int size = instructionSize(opcode);
+			if (!size) return false;
+			pos += size;
+		}
+		return false;
+	}
+
+	// A 64-bit value for a pair of word registers, since that's as big as guest arithmetic gets
+	void splitInt64(const int64_t val, bytecode::types::WordVal& low, bytecode::types::WordVal& high) noexcept {
+		low.int_ = static_cast<bytecode::types::int_t>(static_cast<uint32_t>(val));
+		high.int_ = static_cast<bytecode::types::int_t>(static_cast<uint32_t>(static_cast<uint64_t>(val) >> 32));
+	}
+
+	int64_t nanoseconds() noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Guest Threads
+
+struct executor::VM::Thread {
+	std::unique_ptr<bytecode::Program> program;
+	Stack stack;
+	std::unique_ptr<Meter> meter;
+	// Made by the first task opcode
+	std::unique_ptr<Scheduler> tasks;
+	// Regions BENCH_BEGIN has started and BENCH_END hasn't finished, innermost last, with when they started
+	std::vector<std::pair<bytecode::types::word_t, int64_t>> benchOpen;
+	// Owned by the opcode profile, and made the first time the thread runs with one
+	OpcodeProfile::Counter* costs = nullptr;
+	// The same, for the coverage counter
+	CoverageCount* coverage = nullptr;
+	// Set by setup until the thread first runs, so coverage can count it arriving at its entry
+	bool starting = false;
+	// Instructions dispatched since setup, for INSTR_COUNT. Only the instrumented loop counts them
+	uint64_t retired = 0;
+	// retired when the thread last told the heap profile anything
+	uint64_t heapSeen = 0;
+	// A string on its way between guest memory and the streams, kept here rather than in the loop, which can't own it
+	std::string text;
+
+	// Registers
+	bytecode::types::WordVal wordReg[bytecode::reg::Count];
+	bytecode::types::ByteVal byteReg[bytecode::reg::Count];
+	bool halted;
+
+	// Unused by the main thread, which runs on whatever thread called run or step
+	std::thread host;
+	std::exception_ptr error;
+	std::atomic<bool> joined;
+
+	explicit Thread(const int stackSize, char* const stackAt = nullptr) : stack(stackSize, stackAt), wordReg{}, byteReg{}, halted(true), joined(false) {}
+
+	// Clears the registers and points the special ones at this thread's stack and the program
+	void setup(const bytecode::types::word_t entry) noexcept {
+		using namespace bytecode;
+
+		std::fill(std::begin(wordReg), std::end(wordReg), types::WordVal{});
+		std::fill(std::begin(byteReg), std::end(byteReg), types::ByteVal{});
+
+		// Special registers
+		wordReg[reg::BP].word = VM::address(stack.begin());
+		wordReg[reg::RP].word = VM::address(stack.begin());
+		wordReg[reg::PP].word = VM::address(program->begin());
+		byteReg[reg::FZ].bool_ = 0;
+
+		program->goto_(entry);
+		tasks.reset();
+		halted = false;
+		starting = true;
+		retired = 0;
+		heapSeen = 0;
+	}
+};
+
+bytecode::types::word_t executor::VM::spawn(const bytecode::types::word_t entry, const bytecode::types::word_t arg) {
+	using namespace bytecode;
+
+	auto thread = std::make_unique<Thread>(settings.stackSize);
+	Thread& t = *thread;
+	t.program = std::make_unique<Program>(*main->program, entry);
+	// Always metered, so that it can be stopped
+	t.meter = std::make_unique<Meter>(*t.program, settings, &stopping);
+	t.setup(entry);
+
+	// A frame as if called: the old BP, then a return IP just past the end of the program (so returning ends the thread),
+	// then the argument
+	types::word_t* const frame = reinterpret_cast<types::word_t*>(t.stack.begin());
+	frame[0] = t.wordReg[reg::BP].word;
+	frame[1] = t.program->size();
+	frame[2] = arg;
+
+	const std::lock_guard<std::mutex> lock(threadsMutex);
+	threads.push_back(std::move(thread));
+	try {
+		t.host = std::thread([this, &t] {
+			try {
+				guardedLoop(t, false);
+			} catch (...) {
+				t.error = std::current_exception();
+			}
+		});
+	} catch (...) {
+		threads.pop_back();
+		throw;
+	}
+	return static_cast<types::word_t>(threads.size());
+}
+
+bytecode::types::word_t executor::VM::join(const Thread& self, const bytecode::types::word_t handle, const int loc) {
+	std::unique_ptr<Thread> thread;
+	{
+		const std::lock_guard<std::mutex> lock(threadsMutex);
+		if (handle > 0 && static_cast<size_t>(handle) <= threads.size()) {
+			Thread* const t = threads[handle - 1].get();
+			if (t && t != &self && !t->joined.exchange(true)) {
+				thread = std::move(threads[handle - 1]);
+			}
+		}
+	}
+	if (!thread) throw ExecutorException(ExecutorException::ErrorType::BAD_THREAD, loc);
+
+	thread->host.join();
+	if (thread->error) std::rethrow_exception(thread->error);
+	return thread->wordReg[bytecode::reg::W0].word;
+}
+
+void executor::VM::finishThreads(const bool stop) {
+	if (stop) stopping = true;
+
+	std::exception_ptr error;
+	while (true) {
+		// Threads can still be spawning more, so look again after each join
+		std::unique_ptr<Thread> thread;
+		{
+			const std::lock_guard<std::mutex> lock(threadsMutex);
+			for (std::unique_ptr<Thread>& t : threads) {
+				if (t && !t->joined.exchange(true)) {
+					thread = std::move(t);
+					break;
+				}
+			}
+			if (!thread) {
+				// Joined ones have left their slots, and anything left is being joined by a thread that has now ended
+				threads.clear();
+				break;
+			}
+		}
+
+		thread->host.join();
+		if (thread->error && !error) error = thread->error;
+	}
+
+	stopping = false;
+	if (error && !stop) std::rethrow_exception(error);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Parallel Loops
+
+struct executor::VM::ParallelLoop {
+	bytecode::types::word_t entry;
+	bytecode::types::word_t context;
+	// Ranges no bigger than this are run as one chunk
+	bytecode::types::word_t grain;
+
+	// Ranges handed out but not finished
+	std::atomic<int64_t> remaining;
+	std::atomic<bool> failed;
+	std::mutex errorMutex;
+	std::exception_ptr error;
+};
+
+void executor::VM::parfor(const bytecode::types::word_t entry, const bytecode::types::word_t count, const bytecode::types::word_t context) {
+	using namespace bytecode::types;
+
+	if (count <= 0) return;
+	{
+		const std::lock_guard<std::mutex> lock(poolMutex);
+		if (!pool) pool = std::make_unique<ThreadPool>(settings.workers);
+	}
+
+	ParallelLoop job{};
+	job.entry = entry;
+	job.context = context;
+	// Several chunks per worker, so stealing can even out chunks that take longer than others
+	job.grain = std::max<word_t>(1, count / (pool->size() * 8));
+	job.remaining = 1;
+	pool->submit([this, &job, count] { parforRange(job, 0, count); });
+
+	if (pool->currentWorker() >= 0) {
+		// A PARFOR inside a chunk: keep this worker busy rather than leaving it blocked
+		while (job.remaining.load() != 0) {
+			if (!pool->runOne()) std::this_thread::yield();
+		}
+	} else {
+		for (int64_t left = job.remaining.load(); left != 0; left = job.remaining.load()) {
+			job.remaining.wait(left);
+		}
+	}
+
+	if (job.error) std::rethrow_exception(job.error);
+}
+
+void executor::VM::parforRange(ParallelLoop& job, bytecode::types::word_t first, bytecode::types::word_t end) noexcept {
+	while (end - first > job.grain) {
+		const bytecode::types::word_t mid = first + (end - first) / 2;
+		job.remaining++;
+		pool->submit([this, &job, mid, end] { parforRange(job, mid, end); });
+		end = mid;
+	}
+
+	if (!job.failed.load(std::memory_order_relaxed)) {
+		try {
+			parforChunk(job, first, end);
+		} catch (...) {
+			const std::lock_guard<std::mutex> lock(job.errorMutex);
+			if (!job.error) job.error = std::current_exception();
+			job.failed = true;
+		}
+	}
+
+	if (--job.remaining == 0) job.remaining.notify_all();
+}
+
+void executor::VM::parforChunk(const ParallelLoop& job, const bytecode::types::word_t first, const bytecode::types::word_t end) {
+	using namespace bytecode;
+
+	std::unique_ptr<Thread> context;
+	{
+		const std::lock_guard<std::mutex> lock(contextsMutex);
+		if (!spareContexts.empty()) {
+			context = std::move(spareContexts.back());
+			spareContexts.pop_back();
+		}
+	}
+	if (!context) {
+		context = std::make_unique<Thread>(settings.stackSize);
+		context->program = std::make_unique<Program>(*main->program, job.entry);
+		// Always metered, so that it can be stopped
+		context->meter = std::make_unique<Meter>(*context->program, settings, &stopping);
+	}
+
+	Thread& t = *context;
+	t.setup(job.entry);
+
+	// A frame as if called: the old BP, a return IP just past the end of the program (so returning ends the chunk),
+	// then the range and the context
+	types::word_t* const frame = reinterpret_cast<types::word_t*>(t.stack.begin());
+	frame[0] = t.wordReg[reg::BP].word;
+	frame[1] = t.program->size();
+	frame[2] = first;
+	frame[3] = end;
+	frame[4] = job.context;
+
+	guardedLoop(t, false);
+
+	const std::lock_guard<std::mutex> lock(contextsMutex);
+	spareContexts.push_back(std::move(context));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The VM
+
+executor::VM::VM(const ExecutorSettings& settings) : settings(settings), selectedLoop(selectLoop(settings, false)), heap(std::make_unique<Heap>(settings.heapSize, nullptr)),
+	main(std::make_unique<Thread>(settings.stackSize)), opcodeProfile(settings.flags.hasFlags(FLAG_PROFILE_OPCODES) ? std::make_unique<OpcodeProfile>() : nullptr),
+	sampler(settings.sampleHz > 0 ? std::make_unique<StackSampler>() : nullptr),
+	coverageCounter(settings.coveragePath ? std::make_unique<CoverageCounter>() : nullptr),
+	heapProfile(settings.flags.hasFlags(FLAG_PROFILE_HEAP) ? std::make_unique<HeapProfile>() : nullptr), stopping(false), allocations(0), instream(&std::cin), outstream(&std::cout), requestsPending(0),
+	checkpoints(settings.checkpointPath ? std::make_unique<Checkpoints>() : nullptr) {}
+
+executor::VM::~VM() {
+	finishThreads(true);
+	stopCheckpoints();
+	closeSegments();
+	closeFiles();
+	freeAllocations();
+}
+
+void executor::VM::freeAllocations() noexcept {
+	heap->reset();
+	allocations = 0;
+	if (heapProfile) heapProfile->clear();
+}
+
+void executor::VM::load(std::shared_ptr<const bytecode::Image> image) {
+	this->image = std::move(image);
+	reset();
+}
+
+void executor::VM::reset() {
+	using namespace bytecode;
+
+	if (!image) return;
+
+	finishThreads(true);
+	stopCheckpoints();
+	closeSegments();
+	closeFiles();
+	freeAllocations();
+	{
+		// They point into the old program
+		const std::lock_guard<std::mutex> lock(contextsMutex);
+		spareContexts.clear();
+	}
+	main->stack.reset();
+	main->benchOpen.clear();
+	{
+		const std::lock_guard<std::mutex> lock(benchMutex);
+		benchRegions.clear();
+	}
+	main->costs = nullptr;
+	if (opcodeProfile) opcodeProfile->clear();
+	if (sampler) sampler->clear();
+	main->coverage = nullptr;
+	if (coverageCounter) coverageCounter->clear();
+
+	main->program.reset();
+	try {
+		main->program = std::make_unique<Program>(*image);
+	} catch (const std::bad_alloc&) {
+		throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, 0, "Could not map the program");
+	}
+	meterMain();
+	selectedLoop = selectLoop(settings, countsInstructions(*main->program));
+
+	main->program->goto_(FIRST_INSTR_ADDR_LOCATION);
+	main->setup(*reinterpret_cast<types::word_t*>(main->program->pos()));
+}
+
+void executor::VM::meterMain() {
+	if (checkpoints) {
+		main->meter = std::make_unique<Meter>(*main->program, settings, nullptr, [this](const int ip) { checkpoint(ip); });
+	} else if (settings.maxInstructions > 0 || settings.timeoutMs > 0) {
+		main->meter = std::make_unique<Meter>(*main->program, settings, nullptr);
+	} else {
+		main->meter.reset();
+	}
+}
+
+void executor::VM::run() {
+	if (!main->halted) runMain(false);
+}
+
+bool executor::VM::step() {
+	if (!main->halted) runMain(true);
+	return !main->halted;
+}
+
+void executor::VM::runMain(const bool once) {
+	try {
+		guardedLoop(*main, once);
+	} catch (...) {
+		finishThreads(true);
+		throw;
+	}
+	if (main->halted) finishThreads(false);
+}
+
+void executor::VM::guardedLoop(Thread& thread, const bool once) {
+	struct Args {
+		VM* vm;
+		Thread* thread;
+		bool once;
+	} args{ this, &thread, once };
+
+	if (thread.meter) thread.meter->start();
+	try {
+		if (!thread.stack.guard([](void* const arg) { const Args& a = *static_cast<const Args*>(arg); (a.vm->*a.vm->selectedLoop)(*a.thread, a.once); }, &args)) {
+			throw ExecutorException(ExecutorException::ErrorType::STACK_OVERFLOW, thread.program->offset());
+		}
+	} catch (...) {
+		thread.halted = true;
+		throw;
+	}
+}
+
+void executor::VM::setStreams(std::istream& in, std::ostream& out) noexcept {
+	instream = &in;
+	outstream = &out;
+}
+
+void executor::VM::bindPort(const int id, std::shared_ptr<Channel> channel) {
+	if (id < 0) return;
+	if (static_cast<size_t>(id) >= ports.size()) ports.resize(static_cast<size_t>(id) + 1);
+	ports[id] = std::move(channel);
+}
+
+void executor::VM::addNative(const std::string& name, NativeFunction function) {
+	const uint32_t id = bytecode::nativeId(name);
+	const auto found = natives.find(id);
+	if (found != natives.end() && found->second.first != name) {
+		throw std::invalid_argument("Native function \"" + name + "\" can't be told apart from \"" + found->second.first + "\"");
+	}
+	natives[id] = { name, std::move(function) };
+}
+
+void executor::VM::setMetrics(std::unique_ptr<Metrics> metrics) noexcept {
+	this->metrics = std::move(metrics);
+}
+
+void executor::VM::setRecording(std::unique_ptr<Recording> recording) noexcept {
+	this->recording = std::move(recording);
+}
+
+executor::Channel& executor::VM::port(const bytecode::types::word_t id, const int loc) const {
+	if (id < 0 || static_cast<size_t>(id) >= ports.size() || !ports[id]) {
+		throw ExecutorException(ExecutorException::ErrorType::BAD_PORT, loc, std::to_string(id).c_str());
+	}
+	return *ports[id];
+}
+
+bool executor::VM::isHalted() const noexcept {
+	return main->halted;
+}
+
+int executor::VM::getIP() const noexcept {
+	return main->program ? main->program->offset() : 0;
+}
+
+void executor::VM::setIP(const int ip) noexcept {
+	if (main->program) main->program->goto_(ip);
+}
+
+bytecode::types::WordVal& executor::VM::wordRegister(const bytecode::types::reg_t id) noexcept {
+	return main->wordReg[id];
+}
+
+bytecode::types::ByteVal& executor::VM::byteRegister(const bytecode::types::reg_t id) noexcept {
+	return main->byteReg[id];
+}
+
+char* executor::VM::memory(const bytecode::types::word_t addr) noexcept {
+	return reinterpret_cast<char*>(addr);
+}
+
+bytecode::types::word_t executor::VM::address(const void* const ptr) noexcept {
+	return reinterpret_cast<bytecode::types::word_t>(ptr);
+}
+
+const executor::Stack& executor::VM::getStack() const noexcept {
+	return main->stack;
+}
+
+const bytecode::Program* executor::VM::getProgram() const noexcept {
+	return main->program.get();
+}
+
+size_t executor::VM::getAllocationCount() const noexcept {
+	return allocations;
+}
+
+const std::map<bytecode::types::word_t, executor::VM::BenchRegion>& executor::VM::getBenchRegions() const noexcept {
+	return benchRegions;
+}
+
+executor::StackSampler* executor::VM::getSampler() noexcept {
+	return sampler.get();
+}
+
+executor::HeapProfile* executor::VM::getHeapProfile() noexcept {
+	return heapProfile.get();
+}
+
+executor::CoverageCounter* executor::VM::getCoverageCounter() noexcept {
+	return coverageCounter.get();
+}
+
+executor::OpcodeProfile* executor::VM::getOpcodeProfile() noexcept {
+	return opcodeProfile.get();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Snapshots
+
+// A snapshot is, in order: the magic, the image, the heap (its address and size, then its contents), the program (its
+// address, then its bytes), the allocation count, the main stack (its address and size, then as much of it as was ever used),
+// the registers, and the IP. Everything is in the host's byte order, since it can only be restored on the same kind of host anyway
+namespace {
+	constexpr char SNAPSHOT_MAGIC[8] = { 'Z', 'E', 'D', 'S', 'N', 'A', 'P', 2 };
+
+	template<typename T>
+	void put(std::ostream& out, const T& val) {
+		out.write(reinterpret_cast<const char*>(&val), sizeof(T));
+	}
+
+	template<typename T>
+	T get(std::istream& in) {
+		T val{};
+		in.read(reinterpret_cast<char*>(&val), sizeof(T));
+		return val;
+	}
+
+	executor::ExecutorException badSnapshot(const char* const why, const int loc = 0) {
+		return executor::ExecutorException(executor::ExecutorException::ErrorType::BAD_SNAPSHOT, loc, why);
+	}
+}
+
+void executor::VM::snapshot(std::ostream& out) {
+	if (!image || main->halted) throw badSnapshot("there is no program running");
+	if (const char* const why = unsaveable()) throw badSnapshot(why, getIP());
+
+	writeSnapshot(out, getIP());
+}
+
+const char* executor::VM::unsaveable() {
+	if (main->tasks && main->tasks->running()) return "tasks can't be saved";
+	if (!segments.empty()) return "persistent segments can't be saved";
+	// Closed files leave their slots behind
+	if (std::any_of(files.begin(), files.end(), [](const OpenFile& f) { return f.file != vmem::NO_FILE; })) return "open files can't be saved";
+
+	const std::lock_guard<std::mutex> lock(threadsMutex);
+	if (std::any_of(threads.begin(), threads.end(), [](const std::unique_ptr<Thread>& t) { return t != nullptr; })) {
+		return "threads can't be saved";
+	}
+	return nullptr;
+}
+
+void executor::VM::writeSnapshot(std::ostream& out, const int ip) const {
+	using namespace bytecode::types;
+
+	out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	put<int32_t>(out, image->size());
+	out.write(image->data(), image->size());
+
+	put<word_t>(out, address(heap->begin()));
+	put<uint64_t>(out, heap->getSize());
+	heap->write(out);
+	// The program's own copy, since its globals may have been written
+	put<word_t>(out, address(main->program->begin()));
+	out.write(main->program->begin(), image->size());
+	put<uint64_t>(out, allocations);
+
+	const Stack& stack = main->stack;
+	put<word_t>(out, address(stack.begin()));
+	put<uint64_t>(out, stack.getSize());
+	put<uint64_t>(out, stack.getTouched());
+	out.write(stack.begin(), static_cast<std::streamsize>(stack.getTouched()));
+
+	out.write(reinterpret_cast<const char*>(main->wordReg), sizeof(main->wordReg));
+	out.write(reinterpret_cast<const char*>(main->byteReg), sizeof(main->byteReg));
+	put<int32_t>(out, ip);
+}
+
+void executor::VM::snapshotTo(const Thread& thread, const int loc) {
+	if (&thread != main.get()) throw badSnapshot("only the main thread can take one", loc);
+
+	std::ofstream file(settings.snapshotPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file) throw badSnapshot("could not open the file", loc);
+	snapshot(file);
+	if (!file.flush()) throw badSnapshot("could not write the file", loc);
+}
+
+void executor::VM::restore(std::istream& in) {
+	using namespace bytecode;
+	using namespace bytecode::types;
+
+	finishThreads(true);
+	stopCheckpoints();
+	closeSegments();
+	closeFiles();
+	{
+		const std::lock_guard<std::mutex> lock(contextsMutex);
+		spareContexts.clear();
+	}
+
+	{
+		const std::lock_guard<std::mutex> lock(benchMutex);
+		benchRegions.clear();
+	}
+	main->costs = nullptr;
+	if (opcodeProfile) opcodeProfile->clear();
+	if (sampler) sampler->clear();
+	main->coverage = nullptr;
+	if (coverageCounter) coverageCounter->clear();
+	// What's already allocated wasn't seen being allocated, so the heap profile starts over too
+	if (heapProfile) heapProfile->clear();
+
+	try {
+		char magic[sizeof(SNAPSHOT_MAGIC)]{};
+		in.read(magic, sizeof(magic));
+		if (!in || !std::equal(std::begin(magic), std::end(magic), std::begin(SNAPSHOT_MAGIC))) throw badSnapshot("not a snapshot");
+
+		const int32_t imageSize = get<int32_t>(in);
+		if (!in || imageSize <= 0) throw badSnapshot("no program");
+		image = std::make_shared<const Image>(in, imageSize);
+
+		// The old heap and stack are in the way of where the new ones have to go, if this process happens to have put them there
+		main.reset();
+		heap.reset();
+
+		const word_t heapAt = get<word_t>(in);
+		const uint64_t heapSize = get<uint64_t>(in);
+		if (!in || !heapAt || heapSize > UINT32_MAX) throw badSnapshot("bad heap");
+		try {
+			heap = std::make_unique<Heap>(static_cast<size_t>(heapSize), memory(heapAt));
+		} catch (const ExecutorException&) {
+			throw badSnapshot("the heap's addresses are already in use");
+		}
+		if (!heap->read(in)) throw badSnapshot("bad heap");
+
+		char* const programAt = memory(get<word_t>(in));
+		std::unique_ptr<Program> program;
+		try {
+			program = std::make_unique<Program>(*image, programAt);
+		} catch (const std::bad_alloc&) {
+			throw badSnapshot("the program's addresses are already in use");
+		}
+		{
+			// Only the pages that were written are copied, so the rest stay shared with the image
+			const std::unique_ptr<char[]> bytes = std::make_unique<char[]>(static_cast<size_t>(imageSize));
+			in.read(bytes.get(), imageSize);
+			const size_t page = vmem::pageSize();
+			for (size_t offset = 0; offset < static_cast<size_t>(imageSize); offset += page) {
+				const size_t length = std::min(page, static_cast<size_t>(imageSize) - offset);
+				if (!std::equal(bytes.get() + offset, bytes.get() + offset + length, program->begin() + offset)) {
+					std::copy_n(bytes.get() + offset, length, program->begin() + offset);
+				}
+			}
+		}
+		allocations = static_cast<size_t>(get<uint64_t>(in));
+		if (!in) throw badSnapshot("truncated");
+
+		const word_t stackAt = get<word_t>(in);
+		const uint64_t stackSize = get<uint64_t>(in);
+		const uint64_t touched = get<uint64_t>(in);
+		if (!in || !stackAt || stackSize > INT32_MAX || touched > stackSize) throw badSnapshot("bad stack");
+		try {
+			main = std::make_unique<Thread>(static_cast<int>(stackSize), memory(stackAt));
+		} catch (const ExecutorException&) {
+			throw badSnapshot("the stack's addresses are already in use");
+		}
+		if (!main->stack.touch(static_cast<size_t>(touched))) throw badSnapshot("bad stack");
+		in.read(main->stack.begin(), static_cast<std::streamsize>(touched));
+
+		main->program = std::move(program);
+		meterMain();
+		selectedLoop = selectLoop(settings, countsInstructions(*main->program));
+
+		in.read(reinterpret_cast<char*>(main->wordReg), sizeof(main->wordReg));
+		in.read(reinterpret_cast<char*>(main->byteReg), sizeof(main->byteReg));
+		const int32_t ip = get<int32_t>(in);
+		if (!in || ip < 0 || ip > imageSize) throw badSnapshot("truncated");
+
+		main->program->goto_(ip);
+		main->halted = false;
+
+		while (readDelta(in)) {}
+	} catch (...) {
+		// Leave an empty VM behind, rather than half of a snapshot
+		image.reset();
+		main.reset();
+		if (!heap) heap = std::make_unique<Heap>(settings.heapSize, nullptr);
+		heap->reset();
+		allocations = 0;
+		main = std::make_unique<Thread>(settings.stackSize);
+		throw;
+	}
+}
+
+int executor::VM::clone() {
+#ifdef _WIN32
+	throw ExecutorException(ExecutorException::ErrorType::CLONE_FAILED, getIP(), "not supported on Windows");
+#else
+	{
+		const std::lock_guard<std::mutex> lock(threadsMutex);
+		if (std::any_of(threads.begin(), threads.end(), [](const std::unique_ptr<Thread>& t) { return t != nullptr; })) {
+			throw ExecutorException(ExecutorException::ErrorType::CLONE_FAILED, getIP(), "threads are running");
+		}
+	}
+	{
+		// The child would wait forever for them
+		const std::lock_guard<std::mutex> lock(requestsMutex);
+		if (requestsPending) throw ExecutorException(ExecutorException::ErrorType::CLONE_FAILED, getIP(), "I/O is under way");
+	}
+
+	// Or whatever is buffered would be written twice
+	outstream->flush();
+
+	const pid_t pid = fork();
+	if (pid < 0) throw ExecutorException(ExecutorException::ErrorType::CLONE_FAILED, getIP(), "fork failed");
+
+	if (pid == 0) {
+		// Only the calling thread exists in the child, so the pools have no workers and can't even be shut down
+		// Leak them, and the next PARFOR or AIO_READ makes a new one
+		const std::lock_guard<std::mutex> lock(poolMutex);
+		static_cast<void>(pool.release());
+		static_cast<void>(ioPool.release());
+	}
+	return static_cast<int>(pid);
+#endif
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Checkpoints
+
+// A checkpoint file is a snapshot followed by deltas, each holding the registers, the heap's layout and the pages written
+// since the one before. Deltas are framed, so one cut short by a crash is ignored, and once they add up to more than the
+// snapshot, the next checkpoint starts a new file with a fresh snapshot
+struct executor::VM::Checkpoints {
+	WriteWatch programPages;
+	WriteWatch heapPages;
+	WriteWatch stackPages;
+	// How far the heap and stack reached at the last checkpoint. Pages past those weren't being watched, so count as written
+	size_t heapEnd = 0;
+	size_t stackEnd = 0;
+
+	// Deltas are appended to this. Closed until there's been a snapshot
+	std::ofstream log;
+	uint64_t snapshotBytes = 0;
+	uint64_t deltaBytes = 0;
+	// Whether a skipped checkpoint has been warned about, which only happens once
+	bool warned = false;
+
+	// Stops watching, so the next checkpoint is a snapshot
+	void restart() noexcept {
+		programPages.stop();
+		heapPages.stop();
+		stackPages.stop();
+		if (log.is_open()) log.close();
+		heapEnd = 0;
+		stackEnd = 0;
+		snapshotBytes = 0;
+		deltaBytes = 0;
+	}
+};
+
+namespace {
+	constexpr uint32_t DELTA_MAGIC = 0x544C4544;
+	constexpr uint32_t DELTA_END = 0x454E4F44;
+
+	// Adds the pages of a region that were written while it was watched, and every page after what was watched up to end
+	void writtenPages(const executor::WriteWatch& watch, const size_t watched, char* const base, const size_t end, std::vector<const char*>& pages) {
+		const size_t page = vmem::pageSize();
+		for (size_t i = 0; i < watch.getPages(); i++) {
+			if (watch.isDirty(i)) pages.push_back(watch.begin() + i * page);
+		}
+		for (size_t offset = watched; offset < end; offset += page) {
+			pages.push_back(base + offset);
+		}
+	}
+}
+
+void executor::VM::stopCheckpoints() noexcept {
+	if (checkpoints) checkpoints->restart();
+}
+
+void executor::VM::checkpoint(const int ip) {
+	Checkpoints& cp = *checkpoints;
+	if (const char* const why = unsaveable()) {
+		if (!cp.warned && settings.flags.hasFlags(Flags::FLAG_DEBUG)) {
+			const std::lock_guard<std::mutex> lock(ioMutex);
+			*outstream << IO_WARN "Skipping checkpoints, since " << why << ". They carry on once the program can be saved again" IO_NORM "\n";
+		}
+		cp.warned = true;
+		return;
+	}
+
+	if (!cp.log.is_open() || cp.deltaBytes > cp.snapshotBytes) {
+		cp.restart();
+
+		// Written beside the old file and moved over it, so there's always a whole checkpoint on disk
+		const std::string temp = std::string(settings.checkpointPath) + ".tmp";
+		{
+			std::ostringstream snapshot;
+			writeSnapshot(snapshot, ip);
+			const std::string bytes = snapshot.str();
+			cp.snapshotBytes = bytes.size();
+
+			std::ofstream file(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.write(bytes.data(), static_cast<std::streamsize>(bytes.size())).flush()) {
+				throw badSnapshot("could not write the checkpoint", ip);
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp, settings.checkpointPath, error);
+		if (error) throw badSnapshot("could not write the checkpoint", ip);
+
+		cp.log.open(settings.checkpointPath, std::ios::out | std::ios::binary | std::ios::app);
+	} else {
+		cp.deltaBytes += writeDelta(cp.log, ip);
+		if (!cp.log.flush()) throw badSnapshot("could not write the checkpoint", ip);
+	}
+
+	cp.heapEnd = vmem::roundUp(heap->getTop());
+	cp.stackEnd = main->stack.getTouched();
+	cp.programPages.watch(main->program->begin(), vmem::roundUp(static_cast<size_t>(image->size())));
+	cp.heapPages.watch(heap->begin(), cp.heapEnd);
+	cp.stackPages.watch(main->stack.begin(), cp.stackEnd);
+}
+
+uint64_t executor::VM::writeDelta(std::ostream& out, const int ip) const {
+	using namespace bytecode::types;
+
+	const Checkpoints& cp = *checkpoints;
+	std::vector<const char*> pages;
+	writtenPages(cp.programPages, 0, nullptr, 0, pages);
+	writtenPages(cp.heapPages, cp.heapEnd, heap->begin(), vmem::roundUp(heap->getTop()), pages);
+	writtenPages(cp.stackPages, cp.stackEnd, main->stack.begin(), main->stack.getTouched(), pages);
+
+	std::ostringstream delta;
+	put<int32_t>(delta, ip);
+	delta.write(reinterpret_cast<const char*>(main->wordReg), sizeof(main->wordReg));
+	delta.write(reinterpret_cast<const char*>(main->byteReg), sizeof(main->byteReg));
+	put<uint64_t>(delta, allocations);
+	heap->writeState(delta);
+	put<uint64_t>(delta, main->stack.getTouched());
+
+	const uint32_t page = static_cast<uint32_t>(vmem::pageSize());
+	put<uint32_t>(delta, page);
+	put<uint32_t>(delta, static_cast<uint32_t>(pages.size()));
+	for (const char* const p : pages) {
+		put<word_t>(delta, address(p));
+		delta.write(p, page);
+	}
+
+	const std::string bytes = delta.str();
+	put<uint32_t>(out, DELTA_MAGIC);
+	put<uint64_t>(out, bytes.size());
+	out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	put<uint32_t>(out, DELTA_END);
+	return sizeof(DELTA_MAGIC) + sizeof(uint64_t) + bytes.size() + sizeof(DELTA_END);
+}
+
+bool executor::VM::readDelta(std::istream& in) {
+	using namespace bytecode::types;
+
+	const uint32_t magic = get<uint32_t>(in);
+	const uint64_t length = get<uint64_t>(in);
+	// No delta can be bigger than everything it could have written
+	if (!in || magic != DELTA_MAGIC || length > heap->getSize() + main->stack.getSize() + image->size() + 0x20000) return false;
+
+	std::string bytes(static_cast<size_t>(length), '\0');
+	in.read(bytes.data(), static_cast<std::streamsize>(length));
+	if (get<uint32_t>(in) != DELTA_END || !in) return false;
+
+	std::istringstream delta(bytes);
+	const int32_t ip = get<int32_t>(delta);
+	WordVal wordReg[bytecode::reg::Count];
+	ByteVal byteReg[bytecode::reg::Count];
+	delta.read(reinterpret_cast<char*>(wordReg), sizeof(wordReg));
+	delta.read(reinterpret_cast<char*>(byteReg), sizeof(byteReg));
+	const uint64_t allocs = get<uint64_t>(delta);
+	if (!delta || ip < 0 || ip > main->program->size() || !heap->readState(delta)) throw badSnapshot("bad checkpoint");
+
+	const uint64_t touched = get<uint64_t>(delta);
+	if (!delta || touched > main->stack.getSize() || !main->stack.touch(static_cast<size_t>(touched))) throw badSnapshot("bad checkpoint");
+
+	const uint32_t page = get<uint32_t>(delta);
+	const uint32_t count = get<uint32_t>(delta);
+	if (page != vmem::pageSize()) throw badSnapshot("the checkpoint is from a machine with a different page size");
+
+	char* const programEnd = main->program->begin() + vmem::roundUp(static_cast<size_t>(image->size()));
+	char* const heapEnd = heap->begin() + vmem::roundUp(heap->getTop());
+	char* const stackEnd = main->stack.begin() + touched;
+	for (uint32_t i = 0; i < count; i++) {
+		char* const p = memory(get<word_t>(delta));
+		const bool inHeap = p >= heap->begin() && p + page <= heapEnd;
+		const bool inStack = p >= main->stack.begin() && p + page <= stackEnd;
+		const bool inProgram = p >= main->program->begin() && p + page <= programEnd;
+		if (!delta || !(inHeap || inStack || inProgram)) throw badSnapshot("bad checkpoint");
+		delta.read(p, page);
+	}
+	if (!delta) throw badSnapshot("bad checkpoint");
+
+	std::copy(std::begin(wordReg), std::end(wordReg), main->wordReg);
+	std::copy(std::begin(byteReg), std::end(byteReg), main->byteReg);
+	allocations = static_cast<size_t>(allocs);
+	main->program->goto_(ip);
+	return true;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Persistent Segments
+
+const executor::Segment& executor::VM::openSegment(const char* const name, const bytecode::types::word_t size, const int loc) {
+	// Just a name, so a program can't reach outside the segment directory
+	constexpr size_t MAX_NAME = 255;
+	size_t length = 0;
+	while (length <= MAX_NAME && name[length]) length++;
+	const std::string segmentName(name, length);
+	if (segmentName.empty() || segmentName.size() > MAX_NAME || segmentName == "." || segmentName == ".." ||
+		segmentName.find_first_of("/\\:") != std::string::npos) {
+		throw ExecutorException(ExecutorException::ErrorType::BAD_SEGMENT, loc, "invalid name");
+	}
+	if (size < 0) throw ExecutorException(ExecutorException::ErrorType::BAD_SEGMENT, loc, "invalid size");
+
+	const std::string path = settings.segmentDir ? std::string(settings.segmentDir) + "/" + segmentName : segmentName;
+
+	const std::lock_guard<std::mutex> lock(segmentsMutex);
+	for (const std::unique_ptr<Segment>& segment : segments) {
+		if (segment->getPath() == path) return *segment;
+	}
+
+	std::unique_ptr<Segment> segment = Segment::open(path, static_cast<size_t>(size));
+	if (!segment) throw ExecutorException(ExecutorException::ErrorType::BAD_SEGMENT, loc, segmentName.c_str());
+
+	segments.push_back(std::move(segment));
+	return *segments.back();
+}
+
+char* executor::VM::segmentAlloc(const bytecode::types::word_t root, const bytecode::types::word_t size, const int loc) {
+	const std::lock_guard<std::mutex> lock(segmentsMutex);
+	for (const std::unique_ptr<Segment>& segment : segments) {
+		if (segment->root() != memory(root)) continue;
+
+		// Negative sizes become far too big, and fail
+		char* const ptr = segment->allocate(static_cast<size_t>(size));
+		if (!ptr) throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, loc, "segment full");
+		return ptr;
+	}
+	throw ExecutorException(ExecutorException::ErrorType::BAD_SEGMENT, loc, "not an open segment");
+}
+
+void executor::VM::closeSegments() noexcept {
+	const std::lock_guard<std::mutex> lock(segmentsMutex);
+	segments.clear();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mapped Files
+
+bytecode::types::word_t executor::VM::fileOpen(const char* const path, const bool writable) {
+	const vmem::File file = vmem::openFile(path, writable);
+	if (file == vmem::NO_FILE) return 0;
+
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	for (size_t i = 0; i < files.size(); i++) {
+		if (files[i].file == vmem::NO_FILE) {
+			files[i] = { file, writable };
+			return static_cast<bytecode::types::word_t>(i + 1);
+		}
+	}
+	files.push_back({ file, writable });
+	return static_cast<bytecode::types::word_t>(files.size());
+}
+
+const executor::VM::OpenFile& executor::VM::findFile(const bytecode::types::word_t handle, const int loc) const {
+	if (handle <= 0 || static_cast<size_t>(handle) > files.size() || files[handle - 1].file == vmem::NO_FILE) {
+		throw ExecutorException(ExecutorException::ErrorType::BAD_FILE, loc);
+	}
+	return files[handle - 1];
+}
+
+bytecode::types::word_t executor::VM::fileRemaining(const bytecode::types::word_t handle, const bytecode::types::word_t block, const int loc) {
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	const uint64_t size = vmem::fileSize(findFile(handle, loc).file);
+	if (size == UINT64_MAX) throw ExecutorException(ExecutorException::ErrorType::BAD_FILE, loc, "could not get its size");
+
+	const uint64_t offset = static_cast<uint64_t>(block) * FILE_BLOCK;
+	if (block < 0 || offset >= size) return 0;
+	return static_cast<bytecode::types::word_t>(std::min<uint64_t>(size - offset, INT32_MAX));
+}
+
+char* executor::VM::fileMap(const bytecode::types::word_t handle, const bytecode::types::word_t block, const bytecode::types::word_t length, const int loc) {
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	const OpenFile& file = findFile(handle, loc);
+
+	// Past the end of the file there's nothing to read, and touching it faults
+	const uint64_t size = vmem::fileSize(file.file);
+	const uint64_t offset = static_cast<uint64_t>(block) * FILE_BLOCK;
+	if (block < 0 || length <= 0 || size == UINT64_MAX || offset >= size || static_cast<uint64_t>(length) > size - offset) return nullptr;
+
+	char* const view = vmem::mapView(file.file, offset, static_cast<size_t>(length), file.writable);
+	if (view) views[view] = static_cast<size_t>(length);
+	return view;
+}
+
+void executor::VM::fileSync(const bytecode::types::word_t view, const int loc) {
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	const auto found = views.find(memory(view));
+	if (found == views.end()) throw ExecutorException(ExecutorException::ErrorType::BAD_FILE, loc, "not a mapped view");
+	vmem::flushFile(found->first, found->second);
+}
+
+void executor::VM::fileUnmap(const bytecode::types::word_t view, const int loc) {
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	const auto found = views.find(memory(view));
+	if (found == views.end()) throw ExecutorException(ExecutorException::ErrorType::BAD_FILE, loc, "not a mapped view");
+	// A request might be reading into it
+	finishRequests();
+	vmem::unmapFile(found->first, found->second);
+	views.erase(found);
+}
+
+void executor::VM::fileClose(const bytecode::types::word_t handle, const int loc) {
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	const vmem::File file = findFile(handle, loc).file;
+	finishRequests();
+	vmem::closeFile(file);
+	files[handle - 1].file = vmem::NO_FILE;
+}
+
+void executor::VM::closeFiles() noexcept {
+	const std::lock_guard<std::mutex> lock(filesMutex);
+	finishRequests();
+	{
+		const std::lock_guard<std::mutex> requestsLock(requestsMutex);
+		requests.clear();
+	}
+	for (const auto& [view, size] : views) {
+		vmem::unmapFile(view, size);
+	}
+	views.clear();
+	for (const OpenFile& file : files) {
+		vmem::closeFile(file.file);
+	}
+	files.clear();
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Asynchronous I/O
+
+// A request block is four words: the buffer, its length, and where in the file to start, as a FILE_BLOCK and an offset from it
+struct executor::VM::IoRequest {
+	bool done = false;
+	int64_t result = 0;
+};
+
+bytecode::types::word_t executor::VM::ioSubmit(const bytecode::types::word_t handle, const bytecode::types::word_t request, const bool write, const int loc) {
+	using namespace bytecode::types;
+
+	const word_t* const block = reinterpret_cast<const word_t*>(memory(request));
+	char* const buffer = memory(block[0]);
+	const word_t length = block[1];
+	if (length < 0 || block[2] < 0 || block[3] < 0) throw ExecutorException(ExecutorException::ErrorType::BAD_FILE, loc, "invalid request");
+	const uint64_t offset = static_cast<uint64_t>(block[2]) * FILE_BLOCK + static_cast<uint64_t>(block[3]);
+
+	{
+		const std::lock_guard<std::mutex> lock(poolMutex);
+		if (!ioPool) ioPool = std::make_unique<ThreadPool>(settings.ioWorkers);
+	}
+
+	// Held until the request is counted, so the file can't be closed under it
+	const std::lock_guard<std::mutex> filesLock(filesMutex);
+	const vmem::File file = findFile(handle, loc).file;
+
+	IoRequest* req = nullptr;
+	word_t ticket = 0;
+	{
+		const std::lock_guard<std::mutex> lock(requestsMutex);
+		const auto slot = std::find(requests.begin(), requests.end(), nullptr);
+		ticket = static_cast<word_t>(slot - requests.begin()) + 1;
+		if (slot == requests.end()) {
+			requests.push_back(std::make_unique<IoRequest>());
+			req = requests.back().get();
+		} else {
+			*slot = std::make_unique<IoRequest>();
+			req = slot->get();
+		}
+		requestsPending++;
+	}
+
+	ioPool->submit([this, req, file, offset, buffer, length, write] {
+		const int64_t result = write ? vmem::writeFile(file, offset, buffer, static_cast<size_t>(length))
+			: vmem::readFile(file, offset, buffer, static_cast<size_t>(length));
+
+		const std::lock_guard<std::mutex> lock(requestsMutex);
+		req->result = result;
+		req->done = true;
+		requestsPending--;
+		requestDone.notify_all();
+	});
+	return ticket;
+}
+
+bool executor::VM::ioCollect(const bytecode::types::word_t ticket, const bool wait, bytecode::types::word_t& result, const int loc) {
+	std::unique_lock<std::mutex> lock(requestsMutex);
+	if (ticket <= 0 || static_cast<size_t>(ticket) > requests.size() || !requests[ticket - 1]) {
+		throw ExecutorException(ExecutorException::ErrorType::BAD_TICKET, loc);
+	}
+
+	const IoRequest& req = *requests[ticket - 1];
+	if (wait) {
+		requestDone.wait(lock, [&req] { return req.done; });
+	} else if (!req.done) {
+		return false;
+	}
+
+	result = static_cast<bytecode::types::word_t>(req.result);
+	requests[ticket - 1].reset();
+	return true;
+}
+
+void executor::VM::finishRequests() noexcept {
+	std::unique_lock<std::mutex> lock(requestsMutex);
+	requestDone.wait(lock, [this] { return requestsPending == 0; });
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The Main Loop
+
+executor::VM::Loop executor::VM::selectLoop(const ExecutorSettings& settings, const bool counting) noexcept {
+	// Every combination of features, indexed by them
+	static constexpr auto loops = []<int... features>(std::integer_sequence<int, features...>) {
+		return std::array<Loop, sizeof...(features)>{ &VM::loop<features>... };
+	}(std::make_integer_sequence<int, FEATURE_ALL + 1>());
+
+	int features = 0;
+	if (settings.checksMemory()) features |= FEATURE_CHECK_MEM;
+	if (settings.flags.hasFlags(FLAG_TRACE)) features |= FEATURE_TRACE;
+	if (settings.flags.hasFlags(FLAG_PROFILE_OPCODES) || settings.flags.hasFlags(FLAG_PROFILE_HEAP) || settings.sampleHz > 0 ||
+		settings.coveragePath || settings.metricsInterval > 0 || counting) {
+		features |= FEATURE_INSTRUMENT;
+	}
+	return loops[features];
+}
+
+template<int features>
+void executor::VM::loop(Thread& thread, const bool once) {
+	using namespace bytecode::types;
+	using namespace bytecode::Opcode;
+	using namespace bytecode;
+
+	Program& program = *thread.program;
+	Meter* const meter = thread.meter.get();
+	WordVal* const wordReg = thread.wordReg;
+	ByteVal* const byteReg = thread.byteReg;
+	bool& halted = thread.halted;
+	std::ostream& outstream = *this->outstream;
+	std::istream& instream = *this->instream;
+	Recording* const recording = this->recording.get();
+
+	// Dummy values
+	opcode_t opcode = 0;
+	reg_t rid1 = 0;
+	reg_t rid2 = 0;
+	reg_t rid3 = 0;
+	reg_t rid4 = 0;
+	word_t word = 0;
+	byte_t byte = 0;
+	int_t int_ = 0;
+	char_t char_ = 0;
+	types::float_t float_ = 0;
+	char rlchar = 0;
+	char* charptr = nullptr;
+
+	// For FEATURE_INSTRUMENT. Each profiler's state is null, or its flag unset, unless the settings ask for it
+	constexpr bool instrumented = (features & FEATURE_INSTRUMENT) != 0;
+	OpcodeProfile::Counter* costs = nullptr;
+	CoverageCount* coverage = nullptr;
+	int64_t untilPublish = settings.metricsInterval;
+	if constexpr (instrumented) {
+		if (opcodeProfile) {
+			if (!thread.costs) thread.costs = opcodeProfile->newCounter();
+			costs = thread.costs;
+		}
+		if (coverageCounter) {
+			if (!thread.coverage) thread.coverage = coverageCounter->newCounts(program);
+			coverage = thread.coverage;
+			if (thread.starting) CoverageCounter::enter(coverage, program, program.offset());
+		}
+	}
+	thread.starting = false;
+
+#ifdef _DEBUG
+	// allow the opcode string to show up in the debugger
+	const char* strThingForDebugging;
+#endif
+
+	// Leaving the program means returning from a first frame, which ends the current task or, if there's only the one, the thread
+	while (program.inBounds() || (thread.tasks && thread.tasks->finish(program, wordReg, byteReg))) {
+		if constexpr (instrumented) {
+			if (sampler) sampler->poll(thread.stack, wordReg[reg::BP].word, program);
+			if (metrics && --untilPublish == 0) {
+				untilPublish = settings.metricsInterval;
+				size_t heapBytes;
+				{
+					const std::lock_guard<std::mutex> lock(memMutex);
+					heapBytes = heap->getTop();
+				}
+				metrics->retire(static_cast<uint64_t>(settings.metricsInterval), thread.stack, wordReg[reg::BP].word, program, heapBytes);
+			}
+		}
+		if constexpr ((features & FEATURE_TRACE) != 0) {
+			const std::lock_guard<std::mutex> lock(ioMutex);
+			const opcode_t next = *reinterpret_cast<const opcode_t*>(program.pos());
+			outstream << IO_DEBUG "BYTE" << program.offset() << " " << (next < opcodeCount ? opcodeStrings[next] : "?") << IO_NORM "\n";
+		}
+		program.read<opcode_t>(&opcode);
+		if constexpr (instrumented) {
+			thread.retired++;
+			if (costs) costs->dispatch(opcode);
+		}
+	#ifdef _DEBUG
+		strThingForDebugging = opcodeStrings[opcode];
+	#endif
+		switch (opcode) {
+			case NOP:
+				break;
+
+			case HALT:
+				halted = true;
+				return;
+
+			case BREAK: {
+				const std::lock_guard<std::mutex> lock(ioMutex);
+				while (instream.get() != '\n');
+				break;
+			}
+
+			case ALLOC:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				{
+					const std::lock_guard<std::mutex> lock(memMutex);
+					// Negative sizes become far too big, and fail
+					charptr = heap->allocate(static_cast<size_t>(wordReg[rid2].word));
+					if (charptr) allocations++;
+					if (recording) recording->check(Recording::Event::ALLOC, address(charptr), program.offset());
+					if constexpr (instrumented) {
+						if (heapProfile && charptr) {
+							heapProfile->allocated(thread.stack, wordReg[reg::BP].word, program, program.offset() - instructionSize(ALLOC), charptr,
+												   static_cast<size_t>(wordReg[rid2].word), thread.retired - thread.heapSeen);
+							thread.heapSeen = thread.retired;
+						}
+					}
+				}
+				if (!charptr) throw ExecutorException(ExecutorException::ErrorType::BAD_ALLOC, program.offset(), "out of heap");
+				if constexpr ((features & FEATURE_CHECK_MEM) != 0) {
+					std::memset(charptr, 0xCD, heap->blockSize(charptr));
+				}
+				wordReg[rid1].word = reinterpret_cast<word_t>(charptr);
+				break;
+
+			case FREE: {
+				program.read<reg_t>(&rid1);
+				charptr = reinterpret_cast<char*>(wordReg[rid1].word);
+				if (!charptr) break;
+
+				bool freed = false;
+				{
+					const std::lock_guard<std::mutex> lock(memMutex);
+					if constexpr ((features & FEATURE_CHECK_MEM) != 0) {
+						// Only a live block, and before it's freed, since a free block holds the free list
+						if (const size_t size = heap->blockSize(charptr)) std::memset(charptr, 0xDD, size);
+					}
+					freed = heap->free(charptr);
+					if (freed) allocations--;
+					if constexpr (instrumented) {
+						if (heapProfile && freed) {
+							heapProfile->freed(charptr, thread.retired - thread.heapSeen);
+							thread.heapSeen = thread.retired;
+						}
+					}
+				}
+				if (!freed) throw ExecutorException(ExecutorException::ErrorType::BAD_FREE, program.offset());
+				break;
+			}
+
+			case R_MOV_W:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1] = wordReg[rid2];
+				break;
+
+			case R_MOV_B:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[rid1] = byteReg[rid2];
+				break;
+
+			case MOV_W:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				wordReg[rid1].word = word;
+				break;
+
+			case MOV_B:
+				program.read<reg_t>(&rid1);
+				program.read<byte_t>(&byte);
+				byteReg[rid1].byte = byte;
+				break;
+
+			case LOAD_W:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<word_t>(&word);
+				wordReg[rid1].word = *reinterpret_cast<word_t*>(wordReg[rid2].word + word);
+				break;
+
+			case STORE_W:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid2);
+				*reinterpret_cast<word_t*>(wordReg[rid1].word + word) = wordReg[rid2].word;
+				break;
+
+			case LOAD_B:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<word_t>(&word);
+				byteReg[rid1].byte = *reinterpret_cast<byte_t*>(wordReg[rid2].word + word);
+				break;
+
+			case STORE_B:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid2);
+				*reinterpret_cast<byte_t*>(wordReg[rid1].word + word) = byteReg[rid2].byte;
+				break;
+
+			case JMP:
+				program.read<word_t>(&word);
+				if constexpr (instrumented) CoverageCounter::enter(coverage, program, word);
+				if (meter) meter->branch(program, program.offset(), word);
+				program.goto_(word);
+				break;
+
+			case JMP_Z:
+				program.read<word_t>(&word);
+				if constexpr (instrumented) CoverageCounter::branch(coverage, program, JMP_Z, byteReg[reg::FZ].bool_ == 0, word);
+				if (byteReg[reg::FZ].bool_ == 0) {
+					if (meter) meter->branch(program, program.offset(), word);
+					program.goto_(word);
+				}
+				break;
+
+			case JMP_NZ:
+				program.read<word_t>(&word);
+				if constexpr (instrumented) CoverageCounter::branch(coverage, program, JMP_NZ, byteReg[reg::FZ].bool_ != 0, word);
+				if (byteReg[reg::FZ].bool_ != 0) {
+					if (meter) meter->branch(program, program.offset(), word);
+					program.goto_(word);
+				}
+				break;
+
+			case R_JMP:
+				program.read<reg_t>(&rid1);
+				if constexpr (instrumented) CoverageCounter::enter(coverage, program, wordReg[rid1].word);
+				if (meter) meter->jump(program.offset(), wordReg[rid1].word);
+				program.goto_(wordReg[rid1].word);
+				break;
+
+			case R_JMP_Z:
+				program.read<reg_t>(&rid1);
+				if constexpr (instrumented) CoverageCounter::branch(coverage, program, R_JMP_Z, byteReg[reg::FZ].bool_ == 0, wordReg[rid1].word);
+				if (byteReg[reg::FZ].bool_ == 0) {
+					if (meter) meter->jump(program.offset(), wordReg[rid1].word);
+					program.goto_(wordReg[rid1].word);
+				}
+				break;
+
+			case R_JMP_NZ:
+				program.read<reg_t>(&rid1);
+				if constexpr (instrumented) CoverageCounter::branch(coverage, program, R_JMP_NZ, byteReg[reg::FZ].bool_ != 0, wordReg[rid1].word);
+				if (byteReg[reg::FZ].bool_ != 0) {
+					if (meter) meter->jump(program.offset(), wordReg[rid1].word);
+					program.goto_(wordReg[rid1].word);
+				}
+				break;
+
+			case I_FLAG:
+				program.read<reg_t>(&rid1);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				// TODO : Set other flags if they exist?
+				break;
+
+			case I_CMP_EQ:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == wordReg[rid2].int_ ? 1 : 0;
+				break;
+
+			case I_CMP_NE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ != wordReg[rid2].int_ ? 1 : 0;
+				break;
+
+			case I_CMP_GT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ > wordReg[rid2].int_ ? 1 : 0;
+				break;
+
+			case I_CMP_LT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ < wordReg[rid2].int_ ? 1 : 0;
+				break;
+
+			case I_CMP_GE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ >= wordReg[rid2].int_ ? 1 : 0;
+				break;
+
+			case I_CMP_LE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ <= wordReg[rid2].int_ ? 1 : 0;
+				break;
+
+			case I_INC:
+				program.read<reg_t>(&rid1);
+				wordReg[rid1].int_++;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_DEC:
+				program.read<reg_t>(&rid1);
+				wordReg[rid1].int_--;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_ADD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].int_ = wordReg[rid2].int_ + wordReg[rid3].int_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_SUB:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].int_ = wordReg[rid2].int_ - wordReg[rid3].int_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_MUL:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].int_ = wordReg[rid2].int_ * wordReg[rid3].int_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_DIV:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (wordReg[rid3].int_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
+				wordReg[rid1].int_ = wordReg[rid2].int_ / wordReg[rid3].int_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_MOD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (wordReg[rid3].int_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
+				wordReg[rid1].int_ = wordReg[rid2].int_ % wordReg[rid3].int_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].int_ == 0 ? 0 : 1;
+				break;
+
+			case I_TO_C:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[rid1].char_ = static_cast<char_t>(wordReg[rid2].int_);
+				break;
+
+			case I_TO_F:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].float_ = static_cast<types::float_t>(wordReg[rid2].int_);
+				break;
+
+			case C_FLAG:
+				program.read<reg_t>(&rid1);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				// TODO : Set other flags if they exist?
+				break;
+
+			case C_CMP_EQ:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == byteReg[rid2].char_ ? 1 : 0;
+				break;
+
+			case C_CMP_NE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ != byteReg[rid2].char_ ? 1 : 0;
+				break;
+
+			case C_CMP_GT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ > byteReg[rid2].char_ ? 1 : 0;
+				break;
+
+			case C_CMP_LT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ < byteReg[rid2].char_ ? 1 : 0;
+				break;
+
+			case C_CMP_GE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ >= byteReg[rid2].char_ ? 1 : 0;
+				break;
+
+			case C_CMP_LE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ <= byteReg[rid2].char_ ? 1 : 0;
+				break;
+
+			case C_INC:
+				program.read<reg_t>(&rid1);
+				byteReg[rid1].char_++;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_DEC:
+				program.read<reg_t>(&rid1);
+				byteReg[rid1].char_--;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_ADD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				byteReg[rid1].char_ = byteReg[rid2].char_ + byteReg[rid3].char_;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_SUB:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				byteReg[rid1].char_ = byteReg[rid2].char_ - byteReg[rid3].char_;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_MUL:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				byteReg[rid1].char_ = byteReg[rid2].char_ * byteReg[rid3].char_;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_DIV:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (byteReg[rid3].char_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
+				byteReg[rid1].char_ = byteReg[rid2].char_ / byteReg[rid3].char_;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_MOD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (byteReg[rid3].char_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
+				byteReg[rid1].char_ = byteReg[rid2].char_ % byteReg[rid3].char_;
+				byteReg[reg::FZ].bool_ = byteReg[rid1].char_ == 0 ? 0 : 1;
+				break;
+
+			case C_TO_I:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].int_ = static_cast<char_t>(byteReg[rid2].char_);
+				break;
+
+			case C_TO_F:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].float_ = static_cast<types::float_t>(byteReg[rid2].char_);
+				break;
+
+			case F_FLAG:
+				program.read<reg_t>(&rid1);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
+				// TODO : Set other flags if they exist?
+				break;
+
+			case F_CMP_EQ:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == wordReg[rid2].float_ ? 1 : 0;
+				break;
+
+			case F_CMP_NE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ != wordReg[rid2].float_ ? 1 : 0;
+				break;
+
+			case F_CMP_GT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ > wordReg[rid2].float_ ? 1 : 0;
+				break;
+
+			case F_CMP_LT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ < wordReg[rid2].float_ ? 1 : 0;
+				break;
+
+			case F_CMP_GE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ >= wordReg[rid2].float_ ? 1 : 0;
+				break;
+
+			case F_CMP_LE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ <= wordReg[rid2].float_ ? 1 : 0;
+				break;
+
+			case F_ADD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].float_ = wordReg[rid2].float_ + wordReg[rid3].float_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
+				break;
+
+			case F_SUB:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].float_ = wordReg[rid2].float_ - wordReg[rid3].float_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
+				break;
+
+			case F_MUL:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].float_ = wordReg[rid2].float_ * wordReg[rid3].float_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
+				break;
+
+			case F_DIV:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (wordReg[rid3].float_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
+				wordReg[rid1].float_ = wordReg[rid2].float_ / wordReg[rid3].float_;
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
+				break;
+
+			case F_MOD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (wordReg[rid3].float_ == 0) throw ExecutorException(ExecutorException::ErrorType::DIVIDE_BY_ZERO, program.offset());
+				wordReg[rid1].float_ = wordReg[rid2].float_ * modf(wordReg[rid2].float_ / wordReg[rid3].float_, &float_);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].float_ == 0 ? 0 : 1;
+				break;
+
+			case F_TO_C:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[rid1].char_ = static_cast<char_t>(wordReg[rid2].float_);
+				break;
+
+			case F_TO_I:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].int_ = static_cast<int_t>(wordReg[rid2].float_);
+				break;
+
+			case PRNT_C: {
+				program.read<reg_t>(&rid1);
+				const std::lock_guard<std::mutex> lock(ioMutex);
+				outstream << byteReg[rid1].char_;
+				break;
+			}
+
+			case PRNT_STR: {
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				// Copied out first, since touching guest memory can overflow the stack, which would jump out holding the lock
+				thread.text.assign(reinterpret_cast<char*>(wordReg[rid1].word + word));
+				const std::lock_guard<std::mutex> lock(ioMutex);
+				outstream << thread.text;
+				break;
+			}
+
+			case READ_C: {
+				program.read<reg_t>(&rid1);
+				const auto readChar = [&] {
+					const std::lock_guard<std::mutex> lock(ioMutex);
+					instream.get(rlchar);
+					return rlchar;
+				};
+				byteReg[rid1].char_ = recording ? recording->pass<char>(Recording::Event::READ_C, program.offset(), readChar) : readChar();
+				break;
+			}
+
+			case READ_STR: {
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				const auto readLine = [&] {
+					const std::lock_guard<std::mutex> lock(ioMutex);
+					// getline leaves the string alone if the stream has already failed
+					thread.text.clear();
+					std::getline(instream, thread.text);
+				};
+				if (recording) {
+					recording->passLine(Recording::Event::READ_STR, thread.text, program.offset(), readLine);
+				} else {
+					readLine();
+				}
+				// Copied in after, for the same reason as PRNT_STR
+				charptr = reinterpret_cast<char*>(wordReg[rid1].word + word);
+				std::copy_n(thread.text.c_str(), thread.text.size() + 1, charptr);
+				break;
+			}
+
+			case R_PRNT_I: {
+				program.read<reg_t>(&rid1);
+				const std::lock_guard<std::mutex> lock(ioMutex);
+				outstream << wordReg[rid1].int_;
+				break;
+			}
+
+			case R_PRNT_F: {
+				program.read<reg_t>(&rid1);
+				const std::lock_guard<std::mutex> lock(ioMutex);
+				outstream << wordReg[rid1].float_;
+				break;
+			}
+
+			case PRNT_LN: {
+				const std::lock_guard<std::mutex> lock(ioMutex);
+				outstream << '\n';
+				break;
+			}
+
+			case TIME:
+				program.read<reg_t>(&rid1);
+				wordReg[rid1].int_ = recording ?
+					recording->pass<int_t>(Recording::Event::TIME, program.offset(), [] { return static_cast<int_t>(std::time(nullptr)); }) :
+					static_cast<int_t>(std::time(nullptr));
+				break;
+
+			case SPAWN:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].word = spawn(word, wordReg[rid2].word);
+				break;
+
+			case JOIN:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].word = join(thread, wordReg[rid2].word, program.offset());
+				break;
+
+			case YIELD:
+				if (thread.tasks) thread.tasks->yield(program, wordReg, byteReg);
+				break;
+
+			case TASK_SPAWN:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid2);
+				if (!thread.tasks) thread.tasks = std::make_unique<Scheduler>(settings.taskStackSize, thread.stack);
+				// The task starts whenever it's scheduled, but it's sure to start
+				if constexpr (instrumented) CoverageCounter::enter(coverage, program, word);
+				wordReg[rid1].word = thread.tasks->spawn(program, word, wordReg[rid2].word);
+				break;
+
+			case TASK_WAIT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				if (!thread.tasks) throw ExecutorException(ExecutorException::ErrorType::BAD_TASK, program.offset());
+				thread.tasks->wait(rid1, wordReg[rid2].word, program, wordReg, byteReg);
+				break;
+
+			case CHAN_SEND:
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid1);
+				switch (port(word, program.offset()).send(wordReg[rid1].word)) {
+					case Channel::Status::OK:
+						break;
+					case Channel::Status::CLOSED:
+						throw ExecutorException(ExecutorException::ErrorType::CHANNEL_CLOSED, program.offset(), "nothing is receiving");
+					case Channel::Status::BROKEN:
+						throw ExecutorException(ExecutorException::ErrorType::CHANNEL_CLOSED, program.offset(), "an isolate on the other end failed");
+				}
+				break;
+
+			case CHAN_RECV:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				switch (port(word, program.offset()).receive(wordReg[rid1].word)) {
+					case Channel::Status::OK:
+						byteReg[reg::FZ].bool_ = 1;
+						break;
+					case Channel::Status::CLOSED:
+						// Like the end of input: not an error, just nothing more to come
+						wordReg[rid1].word = 0;
+						byteReg[reg::FZ].bool_ = 0;
+						break;
+					case Channel::Status::BROKEN:
+						throw ExecutorException(ExecutorException::ErrorType::CHANNEL_CLOSED, program.offset(), "an isolate on the other end failed");
+				}
+				break;
+
+			case PARFOR:
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				parfor(word, wordReg[rid1].word, wordReg[rid2].word);
+				break;
+
+			case XADD:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (wordReg[rid2].word % sizeof(word_t)) throw ExecutorException(ExecutorException::ErrorType::MISALIGNED_ATOMIC, program.offset());
+				wordReg[rid1].int_ = std::atomic_ref<int_t>(*reinterpret_cast<int_t*>(wordReg[rid2].word)).fetch_add(wordReg[rid3].int_);
+				break;
+
+			case CMPXCHG:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				if (wordReg[rid1].word % sizeof(word_t)) throw ExecutorException(ExecutorException::ErrorType::MISALIGNED_ATOMIC, program.offset());
+				byteReg[reg::FZ].bool_ = std::atomic_ref<word_t>(*reinterpret_cast<word_t*>(wordReg[rid1].word))
+					.compare_exchange_strong(wordReg[rid2].word, wordReg[rid3].word) ? 1 : 0;
+				break;
+
+			case LOAD_ACQ_W:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<word_t>(&word);
+				if ((wordReg[rid2].word + word) % sizeof(word_t)) throw ExecutorException(ExecutorException::ErrorType::MISALIGNED_ATOMIC, program.offset());
+				wordReg[rid1].word = std::atomic_ref<word_t>(*reinterpret_cast<word_t*>(wordReg[rid2].word + word)).load(std::memory_order_acquire);
+				break;
+
+			case STORE_REL_W:
+				program.read<reg_t>(&rid1);
+				program.read<word_t>(&word);
+				program.read<reg_t>(&rid2);
+				if ((wordReg[rid1].word + word) % sizeof(word_t)) throw ExecutorException(ExecutorException::ErrorType::MISALIGNED_ATOMIC, program.offset());
+				std::atomic_ref<word_t>(*reinterpret_cast<word_t*>(wordReg[rid1].word + word)).store(wordReg[rid2].word, std::memory_order_release);
+				break;
+
+			case P_OPEN: {
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				const Segment& segment = openSegment(memory(wordReg[rid2].word), wordReg[rid3].word, program.offset());
+				wordReg[rid1].word = address(segment.root());
+				// Zero if the segment had to move, so pointers stored in it last time are wrong
+				byteReg[reg::FZ].bool_ = segment.isMoved() ? 0 : 1;
+				break;
+			}
+
+			case P_ALLOC:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].word = address(segmentAlloc(wordReg[rid2].word, wordReg[rid3].word, program.offset()));
+				break;
+
+			case FILE_OPEN:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].word = fileOpen(memory(wordReg[rid2].word), wordReg[rid3].word != 0);
+				byteReg[reg::FZ].bool_ = wordReg[rid1].word ? 1 : 0;
+				break;
+
+			case FILE_SIZE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].word = fileRemaining(wordReg[rid2].word, wordReg[rid3].word, program.offset());
+				break;
+
+			case FILE_MAP:
+				// The first register holds the block to start from, and gets the view
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				charptr = fileMap(wordReg[rid2].word, wordReg[rid1].word, wordReg[rid3].word, program.offset());
+				wordReg[rid1].word = address(charptr);
+				byteReg[reg::FZ].bool_ = charptr ? 1 : 0;
+				break;
+
+			case FILE_SYNC:
+				program.read<reg_t>(&rid1);
+				fileSync(wordReg[rid1].word, program.offset());
+				break;
+
+			case FILE_UNMAP:
+				program.read<reg_t>(&rid1);
+				fileUnmap(wordReg[rid1].word, program.offset());
+				break;
+
+			case FILE_CLOSE:
+				program.read<reg_t>(&rid1);
+				fileClose(wordReg[rid1].word, program.offset());
+				break;
+
+			case AIO_READ:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].word = ioSubmit(wordReg[rid2].word, wordReg[rid3].word, false, program.offset());
+				break;
+
+			case AIO_WRITE:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].word = ioSubmit(wordReg[rid2].word, wordReg[rid3].word, true, program.offset());
+				break;
+
+			case AIO_POLL:
+				// FZ is zero, and the ticket still good, if it hasn't finished
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				byteReg[reg::FZ].bool_ = ioCollect(wordReg[rid2].word, false, wordReg[rid1].word, program.offset()) ? 1 : 0;
+				break;
+
+			case AIO_WAIT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				ioCollect(wordReg[rid2].word, true, wordReg[rid1].word, program.offset());
+				break;
+
+			case NATIVE: {
+				program.read<word_t>(&word);
+				const auto found = natives.find(static_cast<uint32_t>(word));
+				if (found == natives.end()) throw ExecutorException(ExecutorException::ErrorType::UNKNOWN_NATIVE, program.offset());
+				found->second.second(wordReg, byteReg);
+				break;
+			}
+
+			case I_SORT:
+				// Counts below one sort nothing
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				if (wordReg[rid2].int_ > 0) {
+					intrinsics::sortInts(reinterpret_cast<int32_t*>(wordReg[rid1].word), static_cast<size_t>(wordReg[rid2].int_));
+				}
+				break;
+
+			case F_SORT:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				if (wordReg[rid2].int_ > 0) {
+					intrinsics::sortFloats(reinterpret_cast<float*>(wordReg[rid1].word), static_cast<size_t>(wordReg[rid2].int_));
+				}
+				break;
+
+			case I_LOWER:
+				// The first register holds the count, and gets the index
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].int_ = wordReg[rid1].int_ <= 0 ? 0 : static_cast<int_t>(intrinsics::lowerBoundInt(
+					reinterpret_cast<const int32_t*>(wordReg[rid2].word), static_cast<size_t>(wordReg[rid1].int_), wordReg[rid3].int_));
+				break;
+
+			case F_LOWER:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].int_ = wordReg[rid1].int_ <= 0 ? 0 : static_cast<int_t>(intrinsics::lowerBoundFloat(
+					reinterpret_cast<const float*>(wordReg[rid2].word), static_cast<size_t>(wordReg[rid1].int_), wordReg[rid3].float_));
+				break;
+
+			case HASH:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				wordReg[rid1].int_ = wordReg[rid3].int_ <= 0 ? static_cast<int_t>(intrinsics::hash(nullptr, 0))
+					: static_cast<int_t>(intrinsics::hash(memory(wordReg[rid2].word), static_cast<size_t>(wordReg[rid3].int_)));
+				break;
+
+			case RAND_SEED:
+				// The state is four words of guest memory, so it's saved with everything else and each thread can have its own
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				intrinsics::seedRandom(reinterpret_cast<uint32_t*>(wordReg[rid1].word), static_cast<uint32_t>(wordReg[rid2].int_));
+				break;
+
+			case RAND:
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				wordReg[rid1].int_ = static_cast<int_t>(intrinsics::nextRandom(reinterpret_cast<uint32_t*>(wordReg[rid2].word)));
+				break;
+
+			case I_PARSE: {
+				// Parses from the start of the (pointer, length) pair, and moves it past what was parsed
+				// FZ is zero, and nothing changes, if there isn't a number there or it doesn't fit in a word
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				program.read<reg_t>(&rid4);
+				if (wordReg[rid4].int_ < 2 || wordReg[rid4].int_ > 36) throw ExecutorException(ExecutorException::ErrorType::BAD_BASE, program.offset());
+				byteReg[reg::FZ].bool_ = 0;
+				if (wordReg[rid3].int_ <= 0) break;
+
+				charptr = memory(wordReg[rid2].word);
+				const std::from_chars_result result = std::from_chars(charptr, charptr + wordReg[rid3].int_, int_, wordReg[rid4].int_);
+				if (result.ec != std::errc()) break;
+				wordReg[rid1].int_ = int_;
+				wordReg[rid2].word += static_cast<word_t>(result.ptr - charptr);
+				wordReg[rid3].int_ -= static_cast<int_t>(result.ptr - charptr);
+				byteReg[reg::FZ].bool_ = 1;
+				break;
+			}
+
+			case F_PARSE: {
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				byteReg[reg::FZ].bool_ = 0;
+				if (wordReg[rid3].int_ <= 0) break;
+
+				charptr = memory(wordReg[rid2].word);
+				const std::from_chars_result result = std::from_chars(charptr, charptr + wordReg[rid3].int_, float_);
+				if (result.ec != std::errc()) break;
+				wordReg[rid1].float_ = float_;
+				wordReg[rid2].word += static_cast<word_t>(result.ptr - charptr);
+				wordReg[rid3].int_ -= static_cast<int_t>(result.ptr - charptr);
+				byteReg[reg::FZ].bool_ = 1;
+				break;
+			}
+
+			case I_FORMAT: {
+				// Writes at the start of the (pointer, length) pair, without a null, and moves it past what was written
+				// FZ is zero, and nothing changes, if there isn't room
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				program.read<reg_t>(&rid4);
+				if (wordReg[rid4].int_ < 2 || wordReg[rid4].int_ > 36) throw ExecutorException(ExecutorException::ErrorType::BAD_BASE, program.offset());
+				byteReg[reg::FZ].bool_ = 0;
+				if (wordReg[rid2].int_ <= 0) break;
+
+				charptr = memory(wordReg[rid1].word);
+				const std::to_chars_result result = std::to_chars(charptr, charptr + wordReg[rid2].int_, wordReg[rid3].int_, wordReg[rid4].int_);
+				if (result.ec != std::errc()) break;
+				wordReg[rid1].word += static_cast<word_t>(result.ptr - charptr);
+				wordReg[rid2].int_ -= static_cast<int_t>(result.ptr - charptr);
+				byteReg[reg::FZ].bool_ = 1;
+				break;
+			}
+
+			case F_FORMAT: {
+				// The shortest text that parses back to the same float
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				program.read<reg_t>(&rid3);
+				byteReg[reg::FZ].bool_ = 0;
+				if (wordReg[rid2].int_ <= 0) break;
+
+				charptr = memory(wordReg[rid1].word);
+				const std::to_chars_result result = std::to_chars(charptr, charptr + wordReg[rid2].int_, wordReg[rid3].float_);
+				if (result.ec != std::errc()) break;
+				wordReg[rid1].word += static_cast<word_t>(result.ptr - charptr);
+				wordReg[rid2].int_ -= static_cast<int_t>(result.ptr - charptr);
+				byteReg[reg::FZ].bool_ = 1;
+				break;
+			}
+
+			case CLOCK_NS:
+				// Nanoseconds from some fixed point, as low and high words. The low word alone is enough to time under four seconds
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				splitInt64(recording ? recording->pass<int64_t>(Recording::Event::CLOCK_NS, program.offset(), nanoseconds) : nanoseconds(), wordReg[rid1], wordReg[rid2]);
+				break;
+
+			case INSTR_COUNT:
+				// How many instructions this thread has run, this one included, as low and high words
+				program.read<reg_t>(&rid1);
+				program.read<reg_t>(&rid2);
+				splitInt64(static_cast<int64_t>(thread.retired), wordReg[rid1], wordReg[rid2]);
+				break;
+
+			case BENCH_BEGIN:
+				program.read<word_t>(&word);
+				thread.benchOpen.emplace_back(word, nanoseconds());
+				break;
+
+			case BENCH_END: {
+				program.read<word_t>(&word);
+				const int64_t now = nanoseconds();
+				if (thread.benchOpen.empty() || thread.benchOpen.back().first != word) {
+					throw ExecutorException(ExecutorException::ErrorType::BAD_REGION, program.offset(), std::to_string(word).c_str());
+				}
+				const int64_t elapsed = now - thread.benchOpen.back().second;
+				thread.benchOpen.pop_back();
+
+				const std::lock_guard<std::mutex> lock(benchMutex);
+				BenchRegion& region = benchRegions[word];
+				region.count++;
+				region.totalNs += elapsed;
+				region.minNs = std::min(region.minNs, elapsed);
+				region.maxNs = std::max(region.maxNs, elapsed);
+				break;
+			}
+
+			case SNAPSHOT:
+				// Does nothing unless there's somewhere to save it, so a program can mark a good place to resume from
+				if (!settings.snapshotPath) break;
+				snapshotTo(thread, program.offset());
+				halted = true;
+				return;
+
+			default:
+				throw ExecutorException(ExecutorException::ErrorType::UNKNOWN_OPCODE, program.offset());
+				break;
+		}
+
+		if constexpr (instrumented) {
+			if (costs) costs->finish();
+		}
+
+		if (once) return;
+	}
+
+	halted = true;
+}
\ No newline at end of file
@@ -0,0 +1,305 @@
+#pragma once
+#include "executor.h"
+#include "channel.h"
+#include "coverage.h"
+#include "heap.h"
+#include "heap_profile.h"
+#include "metrics.h"
+#include "opcode_profile.h"
+#include "recording.h"
+#include "segment.h"
+#include "stack_sampler.h"
+#include "../utils/bytecode.h"
+#include "../utils/vmem.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+namespace executor {
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// The VM
+
+	class Meter;
+
+	// A host function that programs call with NATIVE, on whichever guest thread calls it, with that thread's registers
+	// Guest addresses are host addresses, so it can use pointers it finds in them as they are
+	typedef std::function<void(bytecode::types::WordVal* wordReg, bytecode::types::ByteVal* byteReg)> NativeFunction;
+
+	// A reusable virtual machine. It owns its registers, stack and dynamic memory, and runs one program at a time
+	// Programs are loaded from shared images, so loading the same image into many VMs never touches the file again
+	// Each VM maps the image copy-on-write, so they all share its code and only copy the pages of globals they write to
+	// SPAWN starts guest threads, each on its own host thread with its own registers and stack. They share the program,
+	// its globals, dynamic memory and streams. A program finishes once its main thread halts and every other thread has ended
+	// PARFOR splits a loop into chunks and runs them on a pool of host threads, which steal chunks from each other as they run dry
+	// The program's bytes, everything ALLOC hands out from the heap and the main stack are the whole of a program's memory
+	// That is what snapshots save, and restore puts back at the same addresses
+	class VM {
+	public:
+		// The times of every pass through one BENCH_BEGIN/BENCH_END region
+		struct BenchRegion {
+			uint64_t count = 0;
+			int64_t totalNs = 0;
+			int64_t minNs = INT64_MAX;
+			int64_t maxNs = 0;
+		};
+
+	private:
+		// One guest thread: the registers, stack and position of an instruction stream
+		struct Thread;
+		// The shared state of one PARFOR
+		struct ParallelLoop;
+		// What has been written since the last checkpoint, and where checkpoints go
+		struct Checkpoints;
+		// An AIO_READ or AIO_WRITE, from when it's submitted until it's collected
+		struct IoRequest;
+
+		// Instrumentation that loop can be built with. Every combination is its own instantiation, so what's left out costs nothing
+		enum Feature {
+			// Fills blocks from ALLOC with 0xCD, and blocks given to FREE with 0xDD, so reading either stands out
+			FEATURE_CHECK_MEM = 1,
+			// Prints each instruction before running it
+			FEATURE_TRACE = FEATURE_CHECK_MEM << 1,
+			// Calls the hooks of whichever profilers the settings ask for. They're rarely wanted, and more rarely wanted apart,
+			// so they share one variant that checks which of them are on, rather than each doubling the number of loops
+			FEATURE_INSTRUMENT = FEATURE_TRACE << 1,
+
+			FEATURE_ALL = (FEATURE_INSTRUMENT << 1) - 1
+		};
+		typedef void (VM::*Loop)(Thread& thread, const bool once);
+		// The loop for the features settings asks for. counting is for programs with INSTR_COUNT, which need the
+		// instrumented loop
+		[[nodiscard]] static Loop selectLoop(const ExecutorSettings& settings, const bool counting) noexcept;
+
+		const ExecutorSettings settings;
+		// Picked from the settings, and again by load and restore, which know whether the program counts instructions
+		Loop selectedLoop;
+
+		std::shared_ptr<const bytecode::Image> image;
+		// Where ALLOC gets memory from
+		std::unique_ptr<Heap> heap;
+		// The thread started by load and reset. Its program owns the bytes every other thread runs
+		std::unique_ptr<Thread> main;
+		// Made when the settings ask for it, and cleared by resets
+		std::unique_ptr<OpcodeProfile> opcodeProfile;
+		std::unique_ptr<StackSampler> sampler;
+		std::unique_ptr<CoverageCounter> coverageCounter;
+		// Told about ALLOC and FREE with memMutex held, so it sees them in the order they happened
+		std::unique_ptr<HeapProfile> heapProfile;
+
+		// Spawned threads, by handle - 1. A slot is emptied once its thread has been joined
+		std::vector<std::unique_ptr<Thread>> threads;
+		std::mutex threadsMutex;
+		// Tells spawned threads to give up, when the main thread fails or the VM is reset
+		std::atomic<bool> stopping;
+
+		// How many blocks ALLOC has handed out that FREE hasn't taken back
+		size_t allocations;
+		std::mutex memMutex;
+
+		std::istream* instream;
+		std::ostream* outstream;
+		std::mutex ioMutex;
+
+		// Opened by POPEN, and closed by resets
+		std::vector<std::unique_ptr<Segment>> segments;
+		std::mutex segmentsMutex;
+
+		// A file opened by FILE_OPEN
+		struct OpenFile {
+			vmem::File file;
+			bool writable;
+		};
+		// By handle - 1. A slot is NO_FILE once closed. Closed by resets, along with everything FILE_MAP mapped
+		std::vector<OpenFile> files;
+		// What FILE_MAP mapped, by address, and how big each view is
+		std::map<char*, size_t> views;
+		std::mutex filesMutex;
+
+		// By ticket - 1. A slot is emptied once its request has been collected
+		std::vector<std::unique_ptr<IoRequest>> requests;
+		// Requests that haven't finished, whether or not they've been collected
+		size_t requestsPending;
+		std::mutex requestsMutex;
+		std::condition_variable requestDone;
+
+		// Channels to other VMs, by port number, for CHAN_SEND and CHAN_RECV. Kept across loads and resets
+		std::vector<std::shared_ptr<Channel>> ports;
+		// What BENCH_END has measured so far, by region. Cleared by resets
+		std::map<bytecode::types::word_t, BenchRegion> benchRegions;
+		std::mutex benchMutex;
+		// Where metrics are published to, if anywhere. Kept across resets
+		std::unique_ptr<Metrics> metrics;
+		// Where READ_C, READ_STR, TIME, CLOCK_NS and ALLOC are recorded or replayed, if anywhere. Kept across resets
+		std::unique_ptr<Recording> recording;
+
+		// For NATIVE, by the nativeId of their names, along with the names. Kept across loads and resets
+		std::unordered_map<uint32_t, std::pair<std::string, NativeFunction>> natives;
+
+		// Contexts that PARFOR chunks have finished with, ready for the next ones
+		std::vector<std::unique_ptr<Thread>> spareContexts;
+		std::mutex contextsMutex;
+		// Made when there's a checkpoint path. After main, since it watches main's stack
+		std::unique_ptr<Checkpoints> checkpoints;
+
+		// Made by the first PARFOR and kept across loads and resets. Last, so it's gone before anything its tasks use
+		std::unique_ptr<ThreadPool> pool;
+		// Made by the first AIO_READ or AIO_WRITE. Separate, so blocking I/O never holds up a PARFOR
+		std::unique_ptr<ThreadPool> ioPool;
+		std::mutex poolMutex;
+
+		// Runs one instruction, or until the thread halts. Runs under Stack::guard, so it can't own anything with a destructor
+		template<int features>
+		void loop(Thread& thread, const bool once);
+		// Runs loop under the thread's Stack::guard, turning an overflow into an exception
+		void guardedLoop(Thread& thread, const bool once);
+		// Runs the main thread, then waits for the others if it halted
+		void runMain(const bool once);
+		void freeAllocations() noexcept;
+		// Gives the main thread a meter, if it needs one for limits or checkpoints
+		void meterMain();
+
+		// For SNAPSHOT: saves the program to settings.snapshotPath
+		void snapshotTo(const Thread& thread, const int loc);
+		// Why the program can't be saved right now, or null if it can: only the main thread, with no tasks still running
+		// and nothing open
+		[[nodiscard]] const char* unsaveable();
+		// Saves the program as if it were at ip
+		void writeSnapshot(std::ostream& out, const int ip) const;
+
+		// Stops watching for writes, so the next checkpoint is a whole snapshot
+		void stopCheckpoints() noexcept;
+		// Called by the main meter when a checkpoint is due. Skipped while the program can't be saved, with a warning the
+		// first time under FLAG_DEBUG
+		void checkpoint(const int ip);
+		// Writes only the pages written since the last checkpoint, returning how many bytes that took
+		uint64_t writeDelta(std::ostream& out, const int ip) const;
+		// Applies the next delta after a snapshot, returning false if there isn't a whole one
+		bool readDelta(std::istream& in);
+		// The channel bound to a port, throwing if there isn't one
+		Channel& port(const bytecode::types::word_t id, const int loc) const;
+
+		// Opens a persistent segment by name, or finds it if it's already open
+		const Segment& openSegment(const char* const name, const bytecode::types::word_t size, const int loc);
+		// Allocates from the segment whose root is at root
+		char* segmentAlloc(const bytecode::types::word_t root, const bytecode::types::word_t size, const int loc);
+		// Flushes and unmaps every segment
+		void closeSegments() noexcept;
+
+		// The file behind a handle, throwing if there isn't one. Only with filesMutex held, since guest threads can close them
+		const OpenFile& findFile(const bytecode::types::word_t handle, const int loc) const;
+		// Opens a file that already exists and returns its handle, or 0 if it can't
+		bytecode::types::word_t fileOpen(const char* const path, const bool writable);
+		// How many bytes of a file there are from block onwards, capped at the biggest word
+		bytecode::types::word_t fileRemaining(const bytecode::types::word_t handle, const bytecode::types::word_t block, const int loc);
+		// Maps length bytes of a file from block onwards, or returns nullptr if the file isn't that long or it can't
+		char* fileMap(const bytecode::types::word_t handle, const bytecode::types::word_t block, const bytecode::types::word_t length, const int loc);
+		// Writes a view's changes back to its file
+		void fileSync(const bytecode::types::word_t view, const int loc);
+		void fileUnmap(const bytecode::types::word_t view, const int loc);
+		// Closes a handle. What was mapped from it stays mapped
+		void fileClose(const bytecode::types::word_t handle, const int loc);
+		// Unmaps every view and closes every file, once no requests are using them
+		void closeFiles() noexcept;
+
+		// Starts reading or writing what the request block at request describes, and returns its ticket
+		bytecode::types::word_t ioSubmit(const bytecode::types::word_t handle, const bytecode::types::word_t request, const bool write, const int loc);
+		// Collects a finished request, putting how many bytes it moved (or -1 if it failed) in result
+		// Returns false if it hasn't finished, unless wait is set, in which case it waits for it
+		bool ioCollect(const bytecode::types::word_t ticket, const bool wait, bytecode::types::word_t& result, const int loc);
+		// Waits until no request is under way
+		void finishRequests() noexcept;
+
+		// Starts a thread at entry, called with arg as if by the usual calling convention, and returns its handle
+		bytecode::types::word_t spawn(const bytecode::types::word_t entry, const bytecode::types::word_t arg);
+		// Waits for a thread and returns its W0, or rethrows whatever stopped it
+		bytecode::types::word_t join(const Thread& self, const bytecode::types::word_t handle, const int loc);
+		// Waits for every thread that hasn't been joined. If stop is set they are told to give up first, and their errors are ignored.
+		// Otherwise the first error is rethrown once they have all ended
+		void finishThreads(const bool stop);
+
+		// Calls entry(first, end, context) over chunks covering [0, count) across the pool, and waits for all of them
+		// Rethrows the first error, after skipping any chunks that hadn't started
+		void parfor(const bytecode::types::word_t entry, const bytecode::types::word_t count, const bytecode::types::word_t context);
+		// Runs part of a PARFOR, splitting off the upper half for other workers to steal until what's left is one chunk
+		void parforRange(ParallelLoop& job, bytecode::types::word_t first, bytecode::types::word_t end) noexcept;
+		// Runs one chunk on a spare context
+		void parforChunk(const ParallelLoop& job, const bytecode::types::word_t first, const bytecode::types::word_t end);
+
+	public:
+		explicit VM(const ExecutorSettings& settings);
+		~VM();
+
+		VM(const VM&) = delete;
+		VM& operator=(const VM&) = delete;
+
+		// Loads a program, replacing any previous one, and resets to its first instruction
+		void load(std::shared_ptr<const bytecode::Image> image);
+		// Puts the loaded program back the way it was right after loading: registers, stack, memory and globals
+		void reset();
+
+		// Runs until the program halts. Programs don't have exit codes, so there's nothing to return
+		void run();
+		// Runs a single instruction of the main thread, returning false once the program has halted
+		bool step();
+
+		// Saves the loaded program as it is now: its memory, registers and position. Throws unless the main thread is all
+		// there is, with no other threads, running tasks, or open files or segments
+		void snapshot(std::ostream& out);
+		// Loads a snapshot, and carries on from where it was taken. Its memory has to go back at the same addresses, since
+		// the program holds pointers into it, so this throws if anything else in this process is already there
+		// A checkpoint file is a snapshot followed by deltas, and this carries on from the last whole one
+		void restore(std::istream& in);
+		// Forks the process, with a copy-on-write copy of the VM in the child. Returns 0 in the child and its process ID
+		// in the parent. Throws on Windows, or if there are threads running
+		int clone();
+
+		// Where PRNT_* and READ_* go. Defaults to std::cin and std::cout
+		void setStreams(std::istream& in, std::ostream& out) noexcept;
+		// Connects a port to a channel, replacing whatever was there
+		void bindPort(const int id, std::shared_ptr<Channel> channel);
+		// Lets programs call a function with "native @name", replacing whatever was added under that name
+		// Throws std::invalid_argument if a different name has the same nativeId
+		void addNative(const std::string& name, NativeFunction function);
+		// Where to publish to, when settings.metricsInterval is set
+		void setMetrics(std::unique_ptr<Metrics> metrics) noexcept;
+		// Where to record inputs to, or replay them from
+		void setRecording(std::unique_ptr<Recording> recording) noexcept;
+
+		[[nodiscard]] bool isHalted() const noexcept;
+		// The offset of the next instruction in the program
+		[[nodiscard]] int getIP() const noexcept;
+		void setIP(const int ip) noexcept;
+
+		[[nodiscard]] bytecode::types::WordVal& wordRegister(const bytecode::types::reg_t id) noexcept;
+		[[nodiscard]] bytecode::types::ByteVal& byteRegister(const bytecode::types::reg_t id) noexcept;
+
+		// Turns a guest address (what the registers hold) into a host pointer
+		[[nodiscard]] static char* memory(const bytecode::types::word_t addr) noexcept;
+		// Turns a host pointer into a guest address
+		[[nodiscard]] static bytecode::types::word_t address(const void* const ptr) noexcept;
+
+		[[nodiscard]] const Stack& getStack() const noexcept;
+		[[nodiscard]] const bytecode::Program* getProgram() const noexcept;
+		// How many ALLOC allocations haven't been freed. Only meaningful while no other threads are running
+		[[nodiscard]] size_t getAllocationCount() const noexcept;
+		// Only meaningful while no other threads are running
+		[[nodiscard]] const std::map<bytecode::types::word_t, BenchRegion>& getBenchRegions() const noexcept;
+		// Null unless the settings ask for FLAG_PROFILE_OPCODES
+		[[nodiscard]] OpcodeProfile* getOpcodeProfile() noexcept;
+		// Null unless the settings ask for a sample rate
+		[[nodiscard]] StackSampler* getSampler() noexcept;
+		// Null unless the settings ask for a coverage path
+		[[nodiscard]] CoverageCounter* getCoverageCounter() noexcept;
+		// Null unless the settings ask for FLAG_PROFILE_HEAP
+		[[nodiscard]] HeapProfile* getHeapProfile() noexcept;
+	};
+}
\ No newline at end of file